@@ -0,0 +1,354 @@
+//------------------------------------------------------------
+//
+// Main_Benchmark
+// Copyright 2019 General Vision Inc.
+//
+// Throughput and latency of the NeuroMem API on the emulator of
+// lib/comm_simu, with and without the bus timing model of the
+// hardware platforms.
+//
+// Usage: Test_Benchmark [output.json] [max neurons]
+// The sweep covers networks of 576 up to max neurons (default 65536,
+// up to 1048576), vector lengths of 16, 64 and 256 and the L1 and LSup
+// norms. Each result reports the host time measured on this computer and
+// the device time predicted by the timing model, and the transactions
+// per call count the transfers on the bus (one SPI transfer per command
+// on the NeuroShield).
+//
+//------------------------------------------------------------
+//
+#include "stdio.h" //for printf
+#include "stdlib.h"
+#include "string.h"
+#include <vector>
+#include <algorithm>
+#include <random>
+#include "../../lib/neuromem/NeuroMem.h"
+#include "../../lib/neuromem/GV_comm.h"
+#include "../../lib/comm_simu/gvcomm_simu.h"
+
+// this variable is defined by the selected NeuroMem platform
+// and corresponds to the maximum vector length fitting in the neurons' memory
+extern int maxveclength;
+
+#define BENCH_FILL			8192	// neurons loaded with WriteNeurons before the recognition runs
+#define BENCH_LEARN			256		// vectors learned per case
+#define BENCH_QUERIES		256		// vectors recognized per case
+#define BENCH_BATCH			32		// vectors per call of LearnBatch and BestMatchBatch
+
+typedef struct
+{
+	const char* name;
+	int preset;
+} Backend;
+
+static const Backend backends[] = {
+	{ "emulator", SIMU_TIMING_OFF },
+	{ "neuroshield", SIMU_TIMING_NEUROSHIELD },
+	{ "brilliant", SIMU_TIMING_BRILLIANT },
+};
+
+typedef struct
+{
+	const char* backend;
+	int neurons;
+	int committed;
+	int veclen;
+	int norm;
+	int k;
+} BenchCase;
+
+// samples of one operation
+typedef struct
+{
+	std::vector<long long> hostNs;
+	std::vector<long long> deviceNs;
+	unsigned long long transactions = 0;
+	unsigned long long bytes = 0;
+} BenchSamples;
+
+static FILE* json = NULL;
+static int jsonCount = 0;
+static std::mt19937 rng(1704);
+
+static long long Percentile(std::vector<long long>& v, double percent)
+{
+	if (v.size() == 0) return(0);
+	std::sort(v.begin(), v.end());
+	size_t rank = (size_t)(v.size() * percent / 100.0);
+	if (rank >= v.size()) rank = v.size() - 1;
+	return(v[rank]);
+}
+
+static double Sum(const std::vector<long long>& v)
+{
+	double sum = 0;
+	for (size_t i = 0; i < v.size(); i++) sum += (double)v[i];
+	return(sum);
+}
+
+// --------------------------------------------------------------
+// Time one call of an operation
+// --------------------------------------------------------------
+class BenchTimer
+{
+public:
+	BenchTimer(BenchSamples* samples)
+	{
+		this->samples = samples;
+		GetCommTotals(&start);
+		startDevice = GetSimuDeviceNs();
+		startNs = CommClock();
+	}
+	~BenchTimer()
+	{
+		long long endNs = CommClock();
+		CommTotals end;
+		GetCommTotals(&end);
+		samples->hostNs.push_back(endNs - startNs);
+		samples->deviceNs.push_back((long long)(GetSimuDeviceNs() - startDevice));
+		samples->transactions += end.count - start.count;
+		samples->bytes += end.bytes - start.bytes;
+	}
+private:
+	BenchSamples* samples;
+	CommTotals start;
+	unsigned long long startDevice;
+	long long startNs;
+};
+
+// --------------------------------------------------------------
+// Print and append the result of an operation to the JSON report
+// device figures are omitted when no timing model is active
+// --------------------------------------------------------------
+static void Report(const char* op, const BenchCase* c, BenchSamples* s)
+{
+	size_t calls = s->hostNs.size();
+	if (calls == 0) return;
+	double hostSum = Sum(s->hostNs), deviceSum = Sum(s->deviceNs);
+	double hostOps = hostSum > 0 ? calls * 1e9 / hostSum : 0;
+	double deviceOps = deviceSum > 0 ? calls * 1e9 / deviceSum : 0;
+	long long hostP50 = Percentile(s->hostNs, 50), hostP99 = Percentile(s->hostNs, 99);
+	long long deviceP50 = Percentile(s->deviceNs, 50), deviceP99 = Percentile(s->deviceNs, 99);
+
+	printf("\n%-12s %-16s N=%-8d veclen=%-4d %s K=%-3d host %12.1f op/s p99 %10.1fus",
+		c->backend, op, c->neurons, c->veclen, c->norm ? "LSup" : "L1  ", c->k, hostOps, hostP99 / 1e3);
+	if (deviceSum > 0) printf("  device %10.1f op/s p99 %12.1fus", deviceOps, deviceP99 / 1e3);
+
+	fprintf(json, "%s\n{\"op\":\"%s\",\"backend\":\"%s\",\"neurons\":%d,\"committed\":%d,\"veclen\":%d,\"norm\":\"%s\",\"k\":%d,"
+		"\"calls\":%u,\"transactions_per_call\":%.1f,\"bytes_per_call\":%.1f,"
+		"\"host_ops_per_s\":%.1f,\"host_p50_us\":%.3f,\"host_p99_us\":%.3f",
+		jsonCount++ ? "," : "", op, c->backend, c->neurons, c->committed, c->veclen, c->norm ? "LSup" : "L1", c->k,
+		(unsigned int)calls, (double)s->transactions / calls, (double)s->bytes / calls,
+		hostOps, hostP50 / 1e3, hostP99 / 1e3);
+	if (deviceSum > 0)
+		fprintf(json, ",\"device_ops_per_s\":%.1f,\"device_p50_us\":%.3f,\"device_p99_us\":%.3f", deviceOps, deviceP50 / 1e3, deviceP99 / 1e3);
+	fprintf(json, "}");
+}
+
+// random vector, or a perturbation of a reference vector
+static void RandomVector(int* vector, int length, const int* reference, int spread)
+{
+	for (int i = 0; i < length; i++)
+	{
+		if (reference == NULL) vector[i] = rng() & 0xFF;
+		else vector[i] = std::min(255, std::max(0, reference[i] + (int)(rng() % (2 * spread + 1)) - spread));
+	}
+}
+
+// sink of ReadNeuronsStream standing for a downstream consumer
+static int ChecksumSink(const NeuronRecord neurons[], int /*first*/, int count, void* user)
+{
+	unsigned int* checksum = (unsigned int*)user;
+	for (int n = 0; n < count; n++)
+		for (int i = 0; i < NM_NEURONSIZE; i++) *checksum = (*checksum * 31) + neurons[n].model[i];
+	return(0);
+}
+
+// --------------------------------------------------------------
+// Run the operations on a network of a given size
+// --------------------------------------------------------------
+static void RunCase(const Backend* backend, int neurons, int veclen, int norm)
+{
+	BenchCase c = { backend->name, neurons, 0, veclen, norm, 0 };
+	SetSimuNeurons(neurons);
+	SimuTiming timing;
+	GetSimuTimingPreset(backend->preset, &timing);
+	SetSimuTiming(backend->preset == SIMU_TIMING_OFF ? NULL : &timing);
+	ResetSimuDeviceNs();
+
+	BenchSamples init;
+	int navail;
+	{
+		BenchTimer t(&init);
+		navail = InitializeNetwork();
+	}
+	Report("InitializeNetwork", &c, &init);
+	setContext(norm ? 0x81 : 0x01, DEFMINIF, DEFMAXIF);
+
+	// knowledge with well separated models, so each one commits a neuron
+	int recLen = maxveclength + 4;
+	int fill = std::min(navail, BENCH_FILL);
+	std::vector<int> knowledge((size_t)fill * recLen, 0);
+	for (int n = 0; n < fill; n++)
+	{
+		int* neuron = &knowledge[(size_t)n * recLen];
+		neuron[0] = norm ? 0x81 : 0x01;
+		RandomVector(neuron + 1, veclen, NULL, 0);
+		neuron[maxveclength + 1] = norm ? 16 : 16 * veclen;
+		neuron[maxveclength + 2] = DEFMINIF;
+		neuron[maxveclength + 3] = 1 + (n % 100);
+	}
+	BenchSamples write;
+	{
+		BenchTimer t(&write);
+		c.committed = WriteNeurons(&knowledge[0], fill);
+	}
+	Report("WriteNeurons", &c, &write);
+
+	std::vector<NeuronRecord> records(fill);
+	for (int n = 0; n < fill; n++)
+	{
+		int* neuron = &knowledge[(size_t)n * recLen];
+		records[n].context = (unsigned short)neuron[0];
+		for (int i = 0; i < NM_NEURONSIZE; i++) records[n].model[i] = (unsigned char)neuron[i + 1];
+		records[n].aif = (unsigned short)neuron[maxveclength + 1];
+		records[n].minif = (unsigned short)neuron[maxveclength + 2];
+		records[n].cat = (unsigned short)neuron[maxveclength + 3];
+	}
+	BenchSamples bulk;
+	double neuronsPerSec;
+	{
+		BenchTimer t(&bulk);
+		c.committed = WriteNeuronsBulk(&records[0], fill, &neuronsPerSec);
+	}
+	Report("WriteNeuronsBulk", &c, &bulk);
+
+	BenchSamples read;
+	std::vector<int> readBack((size_t)c.committed * recLen);
+	{
+		BenchTimer t(&read);
+		ReadNeurons(&readBack[0]);
+	}
+	Report("ReadNeurons", &c, &read);
+
+	BenchSamples stream;
+	unsigned int checksum = 0;
+	{
+		BenchTimer t(&stream);
+		ReadNeuronsStream(256, ChecksumSink, &checksum);
+	}
+	Report("ReadNeuronsStream", &c, &stream);
+
+	std::vector<int> vector(veclen);
+	int distance, category, nid;
+	BenchSamples best;
+	for (int q = 0; q < BENCH_QUERIES; q++)
+	{
+		int n = rng() % fill;
+		RandomVector(&vector[0], veclen, &knowledge[(size_t)n * recLen + 1], 4);
+		BenchTimer t(&best);
+		BestMatch(&vector[0], veclen, &distance, &category, &nid);
+	}
+	Report("BestMatch", &c, &best);
+
+	std::vector<unsigned char> batch((size_t)BENCH_BATCH * veclen);
+	std::vector<int> batchDists(BENCH_BATCH), batchCats(BENCH_BATCH), batchNids(BENCH_BATCH);
+	BenchSamples bestBatch;
+	for (int q = 0; q < BENCH_QUERIES; q += BENCH_BATCH)
+	{
+		for (int b = 0; b < BENCH_BATCH; b++)
+		{
+			int n = rng() % fill;
+			RandomVector(&vector[0], veclen, &knowledge[(size_t)n * recLen + 1], 4);
+			for (int i = 0; i < veclen; i++) batch[(size_t)b * veclen + i] = (unsigned char)vector[i];
+		}
+		BenchTimer t(&bestBatch);
+		BestMatchBatch(&batch[0], veclen, BENCH_BATCH, &batchDists[0], &batchCats[0], &batchNids[0]);
+	}
+	Report("BestMatchBatch", &c, &bestBatch);
+
+	const int Ks[] = { 1, 8, 64 };
+	std::vector<int> dists(64), cats(64), nids(64);
+	for (int k = 0; k < 3; k++)
+	{
+		c.k = Ks[k];
+		BenchSamples reco;
+		for (int q = 0; q < BENCH_QUERIES / 4; q++)
+		{
+			int n = rng() % fill;
+			RandomVector(&vector[0], veclen, &knowledge[(size_t)n * recLen + 1], 4);
+			BenchTimer t(&reco);
+			Recognize(&vector[0], veclen, c.k, &dists[0], &cats[0], &nids[0]);
+		}
+		Report("Recognize", &c, &reco);
+	}
+	c.k = 0;
+
+	BenchSamples learn;
+	for (int l = 0; l < BENCH_LEARN; l++)
+	{
+		RandomVector(&vector[0], veclen, NULL, 0);
+		BenchTimer t(&learn);
+		c.committed = Learn(&vector[0], veclen, 1 + (l % 100));
+	}
+	Report("Learn", &c, &learn);
+
+	std::vector<int> batchCategories(BENCH_BATCH);
+	BenchSamples learnBatch;
+	for (int l = 0; l < BENCH_LEARN; l += BENCH_BATCH)
+	{
+		for (int b = 0; b < BENCH_BATCH; b++)
+		{
+			RandomVector(&vector[0], veclen, NULL, 0);
+			for (int i = 0; i < veclen; i++) batch[(size_t)b * veclen + i] = (unsigned char)vector[i];
+			batchCategories[b] = 1 + ((l + b) % 100);
+		}
+		BenchTimer t(&learnBatch);
+		c.committed = LearnBatch(&batch[0], veclen, BENCH_BATCH, &batchCategories[0]);
+	}
+	Report("LearnBatch", &c, &learnBatch);
+
+	BenchSamples clear;
+	{
+		BenchTimer t(&clear);
+		ClearNeurons();
+	}
+	Report("ClearNeurons", &c, &clear);
+	Disconnect();
+}
+
+int main(int argc, char* argv[])
+{
+	if ((argc > 1) && (argv[1][0] == '-'))
+	{
+		printf("Usage: Test_Benchmark [output.json] [max neurons]\n");
+		return -1;
+	}
+	const char* filename = argc > 1 ? argv[1] : "NeuroMem_benchmark.json";
+	int maxNeurons = argc > 2 ? atoi(argv[2]) : 65536;
+	if (maxNeurons > SIMU_MAXNEURONS) maxNeurons = SIMU_MAXNEURONS;
+	json = fopen(filename, "w");
+	if (json == NULL)
+	{
+		printf("Cannot create %s", filename);
+		return -1;
+	}
+	fprintf(json, "{\"benchmark\":\"NeuroMem API\",\"results\":[");
+
+	const int sizes[] = { 576, 4096, 65536, 1048576 };
+	const int veclens[] = { 16, 64, 256 };
+	for (int b = 0; b < (int)(sizeof(backends) / sizeof(Backend)); b++)
+		for (int s = 0; s < 4; s++)
+		{
+			if (sizes[s] > maxNeurons) break;
+			for (int v = 0; v < 3; v++)
+				for (int norm = 0; norm < 2; norm++)
+					RunCase(&backends[b], sizes[s], veclens[v], norm);
+		}
+
+	fprintf(json, "\n]}\n");
+	fclose(json);
+	printf("\n\nResults saved to %s\n", filename);
+	return(0);
+}
@@ -0,0 +1,453 @@
+//------------------------------------------------------------
+//
+// Main_Features
+// Copyright 2019 General Vision Inc.
+//
+// Feature extraction of lib/features and of the src folder of the
+// NeuroMem library for Arduino, learned and recognized by the emulator
+// of lib/comm_simu on synthetic images and sensor signals:
+//   grey subsamples scanned over a frame and over its pyramid
+//   RGB565 subsample, histogram and profile of an ArduCAM frame
+//   windows of IMU samples queued by a sensor thread
+//   band energies of a vibration signal
+//   IMU windows normalized by their standard deviation
+//   frames captured, extracted and recognized by the stages of a pipeline
+//   API calls profiled from several threads, the timeline is written
+//   to Test_Features_trace.json
+//
+// Usage: Test_Features
+//
+//------------------------------------------------------------
+//
+#include "stdio.h" //for printf
+#include "stdlib.h"
+#include "string.h"
+#include <math.h>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../../lib/neuromem/NeuroMem.h"
+#include "../../lib/neuromem/NeuroMemProfiler.h"
+#include "../../lib/features/GV_features.h"
+#include "../../lib/features/GV_scan.h"
+#include "../../lib/features/GV_pyramid.h"
+#include "../../lib/features/GV_pipeline.h"
+#include "../../../NeuroShield_Arduino/libraries/NeuroMem/src/GV_rgb565.h"
+#include "../../../NeuroShield_Arduino/libraries/NeuroMem/src/GV_window.h"
+#include "../../../NeuroShield_Arduino/libraries/NeuroMem/src/GV_spectrum.h"
+#include "../../../NeuroShield_Arduino/libraries/NeuroMem/src/GV_normalize.h"
+
+#define FRAME_W		320
+#define FRAME_H		240
+#define PI			3.14159265358979
+
+static std::mt19937 rng(2019);
+
+static int Noise(int amplitude)
+{
+	return((int)(rng() % (2 * amplitude + 1)) - amplitude);
+}
+
+static int16_t Clip16(double v)
+{
+	if (v > 32767) return(32767);
+	if (v < -32768) return(-32768);
+	return((int16_t)v);
+}
+
+static void Result(const char* test, int correct, int total)
+{
+	printf("\n%-28s %4d / %4d recognized", test, correct, total);
+}
+
+// --------------------------------------------------------------
+// Grey frame with a checkerboard object of size x size pixels
+// --------------------------------------------------------------
+static void DrawFrame(unsigned char* grey, int left, int top, int size, std::mt19937& random = rng)
+{
+	for (int i = 0; i < FRAME_W * FRAME_H; i++) grey[i] = (unsigned char)(random() % 60);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++) grey[((top + y) * FRAME_W) + left + x] = ((x / (size / 4)) + (y / (size / 4))) & 1 ? 230 : 20;
+	}
+}
+
+#define SCAN_MAXIF	2000	// influence field of the object, the noise being further
+
+static void TestScan()
+{
+	Forget(SCAN_MAXIF);
+	unsigned char* grey = (unsigned char*)malloc(FRAME_W * FRAME_H);
+	unsigned char vector[FEAT_MAXLENGTH];
+	ScanSettings settings = { 32, 32, 4, 4, 1, 4, 4, 0 };
+
+	// learn the object in a first frame, find it in a second one
+	DrawFrame(grey, 40, 40, 32);
+	IntegralImage ii;
+	memset(&ii, 0, sizeof(ii));
+	BuildIntegralImage(&ii, grey, FRAME_W, FRAME_H, FRAME_W);
+	int len = GetGreySubsample(&ii, 40, 40, 32, 32, 4, 4, 1, vector);
+	Learn(vector, len, 1);
+
+	DrawFrame(grey, 200, 120, 32);
+	BuildIntegralImage(&ii, grey, FRAME_W, FRAME_H, FRAME_W);
+	ScanHit hits[256];
+	int found = SurveyROS(&ii, 0, 0, FRAME_W, FRAME_H, &settings, hits, 256);
+	int best = 0;
+	for (int i = 1; (i < found) && (i < 256); i++)
+	{
+		if (hits[i].distance < hits[best].distance) best = i;
+	}
+	printf("\nSurveyROS: %d windows recognized", found);
+	if (found) printf(", closest at %d,%d (object at 216,136) distance %d", hits[best].x, hits[best].y, hits[best].distance);
+
+	// the same object twice as large is found at the next level of the pyramid
+	DrawFrame(grey, 96, 64, 64);
+	ImagePyramid pyramid;
+	memset(&pyramid, 0, sizeof(pyramid));
+	int levels = BuildPyramid(&pyramid, grey, FRAME_W, FRAME_H, FRAME_W, 4, 32, 32);
+	PyramidHit phits[256];
+	int kept = ScanPyramid(&pyramid, 0, 0, FRAME_W, FRAME_H, &settings, NULL, 30, phits, 256);
+	printf("\nScanPyramid: %d levels, %d hits", levels, kept);
+	if (kept) printf(", closest %dx%d at %d,%d level %d (object 64x64 at 128,96)", phits[0].width, phits[0].height, phits[0].x, phits[0].y, phits[0].level);
+
+	FreePyramid(&pyramid);
+	FreeIntegralImage(&ii);
+	free(grey);
+}
+
+// --------------------------------------------------------------
+// RGB565 frame with a blue square on a red background, in the
+// big-endian byte order of the ArduCAM FIFO
+// --------------------------------------------------------------
+static void DrawRGB565(unsigned char* frame, int left, int top, int size)
+{
+	for (int y = 0; y < FRAME_H; y++)
+	{
+		for (int x = 0; x < FRAME_W; x++)
+		{
+			bool inside = (x >= left) && (x < left + size) && (y >= top) && (y < top + size);
+			int r = inside ? 4 : 24 + Noise(3), g = 8 + Noise(3), b = inside ? 26 + Noise(3) : 4;
+			unsigned int color = (r << 11) + (g << 6) + b;
+			frame[(y * FRAME_W + x) * 2] = (unsigned char)(color >> 8);
+			frame[(y * FRAME_W + x) * 2 + 1] = (unsigned char)color;
+		}
+	}
+}
+
+static void TestRGB565()
+{
+	Forget();
+	unsigned char* frame = (unsigned char*)malloc(FRAME_W * FRAME_H * 2);
+	RGB565Features features;
+	RGBComponent vectors[3][RGB_MAXLENGTH];
+	int context, minif, maxif;
+	getContext(&context, &minif, &maxif);
+
+	// learn the square and the background in the contexts 1 to 3 of the three features
+	DrawRGB565(frame, 60, 60, 64);
+	int rois[2][2] = { { 60, 60 }, { 180, 100 } };
+	for (int k = 0; k < 2; k++)
+	{
+		if (GetRGB565Features(&features, frame, FRAME_W * 2, rois[k][0], rois[k][1], 64, 64, 8, 8, 4, vectors[0], vectors[1], vectors[2])) continue;
+		for (int c = 0; c < 3; c++)
+		{
+			setContext(c + 1, minif, maxif);
+			Learn(vectors[c], features.length[c], k + 1);
+		}
+	}
+	// recognize them in a new frame with the square moved
+	DrawRGB565(frame, 150, 20, 64);
+	int moved[2][2] = { { 150, 20 }, { 20, 150 } };
+	int correct = 0, total = 0;
+	for (int k = 0; k < 2; k++)
+	{
+		if (GetRGB565Features(&features, frame, FRAME_W * 2, moved[k][0], moved[k][1], 64, 64, 8, 8, 4, vectors[0], vectors[1], vectors[2])) continue;
+		for (int c = 0; c < 3; c++)
+		{
+			int dist, cat, nid;
+			setContext(c + 1, minif, maxif);
+			BestMatch(vectors[c], features.length[c], &dist, &cat, &nid);
+			if (cat == k + 1) correct++;
+			total++;
+		}
+	}
+	setContext(context, minif, maxif);
+	Result("RGB565 features", correct, total);
+	free(frame);
+}
+
+// --------------------------------------------------------------
+// IMU motions: a swing along ax with a period of 20 samples, or
+// a rotation around gy with a period of 8 samples
+// --------------------------------------------------------------
+#define IMU_CHANNELS	6
+
+static void Motion(int motion, int n, double amplitude, int16_t sample[])
+{
+	for (int c = 0; c < IMU_CHANNELS; c++) sample[c] = (int16_t)Noise(300);
+	if (motion == 1) sample[0] = Clip16(sample[0] + amplitude * sin(2 * PI * n / 20));
+	else sample[4] = Clip16(sample[4] + amplitude * sin(2 * PI * n / 8));
+}
+
+static void TestWindows()
+{
+	Forget();
+	const int learned = 40, tested = 60, length = 20, hop = 3;
+	SampleRing ring;
+	SampleWindow window;
+	RingOpen(&ring, 256, IMU_CHANNELS);
+	WindowOpen(&window, IMU_CHANNELS, length, hop);
+	int correct = 0;
+	for (int motion = 1; motion <= 2; motion++)
+	{
+		int windows = learned + tested;
+		int samples = length + ((windows - 1) * hop);
+		// the sensor thread queues the samples as they are read
+		std::thread sensor([&ring, motion, samples]()
+		{
+			int16_t sample[IMU_CHANNELS];
+			for (int n = 0; n < samples; n++)
+			{
+				Motion(motion, n, 8000, sample);
+				while (RingPush(&ring, sample)) std::this_thread::yield();
+			}
+		});
+		WindowReset(&window);
+		for (int w = 0; w < windows; w++)
+		{
+			const WinComponent* vector;
+			while ((vector = WindowNext(&window, &ring)) == NULL) std::this_thread::yield();
+			if (w < learned) Learn(vector, length * IMU_CHANNELS, motion);
+			else
+			{
+				int dist, cat, nid;
+				BestMatch(vector, length * IMU_CHANNELS, &dist, &cat, &nid);
+				if (cat == motion) correct++;
+			}
+		}
+		sensor.join();
+	}
+	Result("IMU windows", correct, 2 * tested);
+	WindowClose(&window);
+	RingClose(&ring);
+}
+
+static void TestNormalize()
+{
+	Forget();
+	const int learned = 20, tested = 40, length = 32;
+	Normalizer norm;
+	NormalizeOpen(&norm, NORM_ZSCORE, length * IMU_CHANNELS, IMU_CHANNELS);
+	std::vector<int16_t> raw(length * IMU_CHANNELS);
+	NormComponent vector[NORM_MAXLENGTH];
+	int correct = 0;
+	// learned at one amplitude, recognized at three times the amplitude
+	for (int k = 0; k < learned + tested; k++)
+	{
+		int motion = 1 + (k & 1);
+		double amplitude = k < learned ? 3000 : 9000;
+		int start = (int)(rng() % 40);
+		for (int n = 0; n < length; n++) Motion(motion, start + n, amplitude, &raw[n * IMU_CHANNELS]);
+		NormalizeBlock(&norm, raw.data(), 1, vector);
+		if (k < learned) Learn(vector, length * IMU_CHANNELS, motion);
+		else
+		{
+			int dist, cat, nid;
+			BestMatch(vector, length * IMU_CHANNELS, &dist, &cat, &nid);
+			if (cat == motion) correct++;
+		}
+	}
+	Result("IMU windows normalized", correct, tested);
+}
+
+// --------------------------------------------------------------
+// Vibration at 20 or 60 cycles per window of 256 samples
+// --------------------------------------------------------------
+static void TestSpectrum()
+{
+	Forget();
+	const int learned = 10, tested = 40, fftSize = 256, hop = 64, bands = 32;
+	SpectrumStream spectrum;
+	if (SpectrumOpen(&spectrum, fftSize, hop, bands, SPEC_LOGBANDS))
+	{
+		printf("\nSpectrumOpen failed");
+		return;
+	}
+	int correct = 0;
+	for (int machine = 1; machine <= 2; machine++)
+	{
+		double cycles = machine == 1 ? 20 : 60;
+		SpectrumReset(&spectrum);
+		int windows = 0;
+		for (int n = 0; windows < learned + tested; n++)
+		{
+			const SpecComponent* vector = SpectrumAdd(&spectrum, Clip16((4000 * sin(2 * PI * cycles * n / fftSize)) + Noise(400)));
+			if (vector == NULL) continue;
+			if (windows < learned) Learn(vector, bands, machine);
+			else
+			{
+				int dist, cat, nid;
+				BestMatch(vector, bands, &dist, &cat, &nid);
+				if (cat == machine) correct++;
+			}
+			windows++;
+		}
+	}
+	Result("Vibration spectrum", correct, 2 * tested);
+	SpectrumClose(&spectrum);
+}
+
+// --------------------------------------------------------------
+// Frames with the checkerboard object or the background only,
+// captured, extracted by 2 workers and recognized by the neurons
+// --------------------------------------------------------------
+#define PIPE_FRAMES		64
+#define PIPE_ROI		96		// ROI of the object in the frames
+
+typedef struct
+{
+	int index;
+	bool object;
+	unsigned char grey[FRAME_W * FRAME_H];
+	IntegralImage ii;
+	unsigned char vector[FEAT_MAXLENGTH];
+	int length;
+	int distance, category;
+} PipeFrame;
+
+static int CaptureStage(void*, void* item)
+{
+	PipeFrame* frame = (PipeFrame*)item;
+	std::mt19937 sensor(frame->index);	// workers do not share the generator
+	if (frame->object) DrawFrame(frame->grey, PIPE_ROI, PIPE_ROI, 32, sensor);
+	else DrawFrame(frame->grey, PIPE_ROI, PIPE_ROI, 0, sensor);
+	return(0);
+}
+
+static int ExtractStage(void*, void* item)
+{
+	PipeFrame* frame = (PipeFrame*)item;
+	if (BuildIntegralImage(&frame->ii, frame->grey, FRAME_W, FRAME_H, FRAME_W) != 0) return(1);
+	frame->length = GetGreySubsample(&frame->ii, PIPE_ROI, PIPE_ROI, 32, 32, 4, 4, 1, frame->vector);
+	return(frame->length == 0 ? 1 : 0);
+}
+
+// the only stage calling the NeuroMem API, with a single worker
+static int RecognizeStage(void*, void* item)
+{
+	PipeFrame* frame = (PipeFrame*)item;
+	int nid;
+	BestMatch(frame->vector, frame->length, &frame->distance, &frame->category, &nid);
+	return(0);
+}
+
+static void TestPipeline()
+{
+	Forget(SCAN_MAXIF);
+	std::vector<PipeFrame> frames(PIPE_FRAMES);
+	for (int i = 0; i < PIPE_FRAMES; i++)
+	{
+		memset(&frames[i].ii, 0, sizeof(IntegralImage));
+		frames[i].index = i;
+		frames[i].object = (i & 1) == 0;
+		frames[i].distance = 0xFFFF;
+	}
+	// learn the object of the first frame
+	CaptureStage(NULL, &frames[0]);
+	ExtractStage(NULL, &frames[0]);
+	Learn(frames[0].vector, frames[0].length, 1);
+
+	PipelineStage stages[3] = {
+		{ "capture", CaptureStage, NULL, 1, 4 },
+		{ "extract", ExtractStage, NULL, 2, 4 },
+		{ "recognize", RecognizeStage, NULL, 1, 4 },
+	};
+	Pipeline* pipeline = PipelineOpen(stages, 3);
+	for (int i = 0; i < PIPE_FRAMES; i++) PipelineSubmit(pipeline, &frames[i]);
+	PipelineDrain(pipeline);
+	int correct = 0;
+	for (int i = 0; i < PIPE_FRAMES; i++)
+	{
+		if (frames[i].object ? (frames[i].category == 1) : (frames[i].distance == 0xFFFF)) correct++;
+		FreeIntegralImage(&frames[i].ii);
+	}
+	Result("Pipeline frames", correct, PIPE_FRAMES);
+	PipelineReport(pipeline, stdout);
+	PipelineClose(pipeline);
+}
+
+// --------------------------------------------------------------
+// Profiler of the API calls: nesting kept when it starts inside a
+// call, calls of several threads charged once each, trace written
+// --------------------------------------------------------------
+#define PROFILE_THREADS		4
+#define PROFILE_CALLS		1000
+
+static unsigned long long ProfiledCalls(const char* name)
+{
+	ProfilerEntry entries[64];
+	int n = ProfilerGetEntries(entries, 64);
+	for (int i = 0; i < n; i++)
+		if (strcmp(entries[i].name, name) == 0) return(entries[i].calls);
+	return(0);
+}
+
+static void ProfiledThread()
+{
+	for (int i = 0; i < PROFILE_CALLS; i++)
+	{
+		NM_PROFILE("Worker");
+		ProfilerScope nested("Nested");
+	}
+}
+
+static void TestProfiler()
+{
+	unsigned char vector[16];
+	for (int i = 0; i < 16; i++) vector[i] = (unsigned char)(i * 16);
+	Forget();
+	ProfilerReset();
+	ProfilerStart();
+	{
+		// started again inside a profiled call
+		NM_PROFILE("Outer");
+		ProfilerStart();
+	}
+	Learn(vector, 16, 1);
+	int distance, category, nid;
+	std::thread recognizer([&]() { BestMatch(vector, 16, &distance, &category, &nid); });
+	recognizer.join();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < PROFILE_THREADS; t++) threads.push_back(std::thread(ProfiledThread));
+	for (int t = 0; t < PROFILE_THREADS; t++) threads[t].join();
+	ProfilerStop();
+
+	bool charged = (ProfiledCalls("Outer") == 1) && (ProfiledCalls("Learn") == 1) && (ProfiledCalls("Broadcast") == 0)
+		&& (ProfiledCalls("BestMatch") == 1) && (ProfiledCalls("Worker") == PROFILE_THREADS * PROFILE_CALLS)
+		&& (ProfiledCalls("Nested") == 0);
+	printf("\n%-28s %s", "Profiled calls", charged ? "passed" : "FAILED");
+	ProfilerReport(stdout);
+	int error = ProfilerWriteTrace("Test_Features_trace.json");
+	printf("%-28s %s", "Profiler trace", error == 0 ? "passed" : "FAILED");
+}
+
+int main()
+{
+	int navail = InitializeNetwork();
+	if (navail == 0)
+	{
+		printf("Did not detect the NeuroMem platform!");
+		return -1;
+	}
+	printf("\nAvailable neurons: \t%u", navail);
+	TestScan();
+	TestRGB565();
+	TestWindows();
+	TestNormalize();
+	TestSpectrum();
+	TestPipeline();
+	TestProfiler();
+	printf("\n");
+	return 0;
+}
@@ -0,0 +1,425 @@
+//------------------------------------------------------------
+//
+// Main_Knowledge
+// Copyright 2019 General Vision Inc.
+//
+// Round trips of the knowledge saved by the NeuroMem API, on the
+// emulator of lib/comm_simu:
+//   Adler-32 and LZ codec of the knowledge files
+//   knowledge files of 4-byte and 2-byte ints, compact, compressed
+//   and converted, loaded or mapped into the emulator
+//   CogniSight projects and their MINIF and MAXIF
+//   snapshots and learning journal recovered after a crash
+//
+// Each check compares the neurons read back with ReadNeurons to the
+// neurons of the network they were saved from. The files are created
+// in the working directory and removed at the end.
+//
+// Usage: Test_Knowledge
+//
+//------------------------------------------------------------
+//
+#include "stdio.h" //for printf
+#include "stdlib.h"
+#include "string.h"
+#include <random>
+#include <vector>
+#include "../../lib/neuromem/NeuroMem.h"
+#include "../../lib/neuromem/GV_comm.h"
+#include "../../lib/neuromem/NeuroMemKnowledge.h"
+#include "../../lib/neuromem/NeuroMemSnapshot.h"
+#include "../../lib/neuromem/NeuroMemJournal.h"
+#include "../../lib/comm_simu/gvcomm_simu.h"
+
+#define VECLEN		32
+
+static std::mt19937 rng(1704);
+static int failures = 0;
+
+static void Check(const char* test, bool passed)
+{
+	printf("\n%-44s %s", test, passed ? "passed" : "FAILED");
+	if (!passed) failures++;
+}
+
+static void RandomVector(unsigned char* vector, int length)
+{
+	for (int i = 0; i < length; i++) vector[i] = (unsigned char)(rng() & 0xFF);
+}
+
+// content of the network
+static std::vector<NeuronRecord> Neurons()
+{
+	std::vector<NeuronRecord> neurons(GetCommitted() + 1);
+	neurons.resize(ReadNeurons(&neurons[0]));
+	return(neurons);
+}
+
+static bool SameNeurons(const std::vector<NeuronRecord>& a, const std::vector<NeuronRecord>& b)
+{
+	return((a.size() == b.size()) && ((a.size() == 0) || (memcmp(&a[0], &b[0], a.size() * sizeof(NeuronRecord)) == 0)));
+}
+
+// count vectors learned one by one or by LearnBatch, about one in
+// four close to a learned vector of another category to shrink its AIF
+static void LearnVectors(int count, bool batch, std::vector<unsigned char>& learned)
+{
+	std::vector<unsigned char> vectors((size_t)count * VECLEN);
+	std::vector<int> categories(count);
+	for (int i = 0; i < count; i++)
+	{
+		unsigned char* vector = &vectors[(size_t)i * VECLEN];
+		size_t known = learned.size() / VECLEN;
+		if ((known > 0) && (rng() % 4 == 0))
+		{
+			memcpy(vector, &learned[(rng() % known) * VECLEN], VECLEN);
+			vector[rng() % VECLEN] ^= 0x10;
+		}
+		else RandomVector(vector, VECLEN);
+		categories[i] = 1 + (rng() % 10);
+	}
+	if (batch) LearnBatch(&vectors[0], VECLEN, count, &categories[0]);
+	else for (int i = 0; i < count; i++) Learn(&vectors[(size_t)i * VECLEN], VECLEN, categories[i]);
+	learned.insert(learned.end(), vectors.begin(), vectors.end());
+}
+
+// --------------------------------------------------------------
+// Adler-32 and LZ blocks of the compressed models
+// --------------------------------------------------------------
+static void TestCodec()
+{
+	const unsigned char text[] = "Wikipedia";
+	unsigned int adler = KnowledgeAdler32(1, text, 9);
+	Check("Adler-32 of \"Wikipedia\"", adler == 0x11E60398);
+	Check("Adler-32 in two parts", KnowledgeAdler32(KnowledgeAdler32(1, text, 4), text + 4, 5) == adler);
+	std::vector<unsigned char> large(1 << 20, 0xFF);
+	unsigned int sum = 1;
+	for (size_t i = 0; i < large.size(); i += 4096) sum = KnowledgeAdler32(sum, &large[i], 4096);
+	Check("Adler-32 of 1 MB in 4 KB parts", KnowledgeAdler32(1, &large[0], large.size()) == sum);
+
+	// models: null, random, a learned vector followed by zeros, repeated
+	// patterns and runs longer than a token
+	unsigned char models[6][NM_NEURONSIZE];
+	memset(models[0], 0, NM_NEURONSIZE);
+	RandomVector(models[1], NM_NEURONSIZE);
+	memset(models[2], 0, NM_NEURONSIZE);
+	RandomVector(models[2], VECLEN);
+	for (int i = 0; i < NM_NEURONSIZE; i++) models[3][i] = (unsigned char)(i % 3);
+	for (int i = 0; i < NM_NEURONSIZE; i++) models[4][i] = (unsigned char)((i / 40) * 50);
+	for (int i = 0; i < NM_NEURONSIZE; i++) models[5][i] = (unsigned char)(i < 200 ? rng() & 0x03 : 0x80);
+	bool roundTrip = true, bounded = true;
+	int lengths[] = { 1, 2, 3, 127, 128, 129, NM_NEURONSIZE };
+	for (int m = 0; m < 6; m++)
+	{
+		for (int l = 0; l < 7; l++)
+		{
+			unsigned char packed[NM_NEURONSIZE + (NM_NEURONSIZE / 128) + 1], unpacked[NM_NEURONSIZE];
+			int length = KnowledgeCompress(models[m], lengths[l], packed);
+			if (length > lengths[l] + (lengths[l] / 128) + 1) bounded = false;
+			if ((KnowledgeDecompress(packed, length, unpacked, lengths[l]) != 0) || (memcmp(unpacked, models[m], lengths[l]) != 0))
+				roundTrip = false;
+		}
+	}
+	Check("LZ blocks decoded to the models", roundTrip);
+	Check("LZ blocks within their bound", bounded);
+
+	unsigned char packed[NM_NEURONSIZE + 3], unpacked[NM_NEURONSIZE];
+	Check("Null model compressed", KnowledgeCompress(models[0], NM_NEURONSIZE, packed) < 8);
+	int length = KnowledgeCompress(models[2], NM_NEURONSIZE, packed);
+	bool rejected = (KnowledgeDecompress(packed, length - 1, unpacked, NM_NEURONSIZE) != 0)
+		&& (KnowledgeDecompress(packed, length, unpacked, NM_NEURONSIZE - 1) != 0);
+	unsigned char farCopy[2] = { 0x80, 10 };	// copy from before the block
+	rejected = rejected && (KnowledgeDecompress(farCopy, 2, unpacked, 3) != 0);
+	Check("Truncated and invalid LZ blocks rejected", rejected);
+}
+
+// --------------------------------------------------------------
+// Knowledge files of all the formats loaded back into the network
+// --------------------------------------------------------------
+#define KN_FILE		"Test_Knowledge.knf"
+#define KN_FILE2	"Test_Knowledge.gvkn"
+#define CSP_FILE	"Test_Knowledge.csp"
+
+static void Put(unsigned char* p, unsigned int value, int bytes)
+{
+	for (int i = 0; i < bytes; i++) p[i] = (unsigned char)((value >> (8 * i)) & 0xFF);
+}
+
+// records of KN_FORMAT with ints of intBytes, as the Arduino boards write them
+static bool PutRecords(FILE* f, const std::vector<NeuronRecord>& neurons, int intBytes)
+{
+	std::vector<unsigned char> record((NM_NEURONSIZE + 4) * intBytes);
+	for (size_t n = 0; n < neurons.size(); n++)
+	{
+		Put(&record[0], neurons[n].context, intBytes);
+		for (int i = 0; i < NM_NEURONSIZE; i++) Put(&record[(i + 1) * intBytes], neurons[n].model[i], intBytes);
+		Put(&record[(NM_NEURONSIZE + 1) * intBytes], neurons[n].aif, intBytes);
+		Put(&record[(NM_NEURONSIZE + 2) * intBytes], neurons[n].minif, intBytes);
+		Put(&record[(NM_NEURONSIZE + 3) * intBytes], neurons[n].cat, intBytes);
+		if (fwrite(&record[0], 1, record.size(), f) != record.size()) return(false);
+	}
+	return(true);
+}
+
+static bool WriteFile16(const char* filename, const std::vector<NeuronRecord>& neurons)
+{
+	FILE* f = fopen(filename, "wb");
+	if (f == NULL) return(false);
+	unsigned char header[8];
+	Put(header, KN_FORMAT, 2);
+	Put(header + 2, NM_NEURONSIZE, 2);
+	Put(header + 4, (unsigned int)neurons.size(), 2);
+	Put(header + 6, 0, 2);
+	bool written = (fwrite(header, 1, 8, f) == 8) && PutRecords(f, neurons, 2);
+	return((fclose(f) == 0) && written);
+}
+
+// load a file into an emptied network and compare its neurons
+static bool Reloaded(const char* filename, const std::vector<NeuronRecord>& neurons)
+{
+	Forget();
+	return((LoadKnowledge(filename) == 0) && SameNeurons(neurons, Neurons()));
+}
+
+static bool SameFiles(const char* a, const char* b)
+{
+	FILE* fa = fopen(a, "rb");
+	FILE* fb = fopen(b, "rb");
+	bool same = (fa != NULL) && (fb != NULL);
+	while (same)
+	{
+		int ca = fgetc(fa), cb = fgetc(fb);
+		same = ca == cb;
+		if (ca == EOF) break;
+	}
+	if (fa != NULL) fclose(fa);
+	if (fb != NULL) fclose(fb);
+	return(same);
+}
+
+// flip a bit of a file at offset from its end
+static void Corrupt(const char* filename, long fromEnd)
+{
+	FILE* f = fopen(filename, "r+b");
+	if (f == NULL) return;
+	fseek(f, -fromEnd, SEEK_END);
+	int c = fgetc(f);
+	fseek(f, -fromEnd, SEEK_END);
+	fputc(c ^ 0x01, f);
+	fclose(f);
+}
+
+static void Truncate(const char* filename, long length)
+{
+	std::vector<unsigned char> data(length);
+	FILE* f = fopen(filename, "rb");
+	if (f == NULL) return;
+	size_t n = fread(&data[0], 1, length, f);
+	fclose(f);
+	f = fopen(filename, "wb");
+	if (f == NULL) return;
+	fwrite(&data[0], 1, n, f);
+	fclose(f);
+}
+
+static void TestKnowledgeFiles()
+{
+	Forget();
+	std::vector<unsigned char> learned;
+	LearnVectors(150, true, learned);
+	setContext(5, DEFMINIF, 0x0800);
+	LearnVectors(50, false, learned);
+	setContext(1, DEFMINIF, DEFMAXIF);
+	std::vector<NeuronRecord> neurons = Neurons();
+
+	Check("KN_FORMAT saved and loaded", (SaveKnowledge(KN_FILE) == 0) && Reloaded(KN_FILE, neurons));
+	Check("KN_FORMAT of 2-byte ints loaded", WriteFile16(KN_FILE2, neurons) && Reloaded(KN_FILE2, neurons));
+	Check("KN_COMPACT saved and loaded", (SaveKnowledge(KN_FILE2, KN_COMPACT, 0) == 0) && Reloaded(KN_FILE2, neurons));
+#ifndef _WIN32
+	Forget();
+	bool mapped = (MapSimuKnowledge(KN_FILE2, 1) == 0) && (IsSimuKnowledgeMapped() == 1) && SameNeurons(neurons, Neurons());
+	Check("KN_COMPACT mapped", mapped);
+	LearnVectors(10, false, learned);
+	InitializeNetwork();
+	Check("Mapped file unchanged by the learning", Reloaded(KN_FILE2, neurons));
+#endif
+	Check("KN_COMPACT compressed saved and loaded", (SaveKnowledge(KN_FILE2, KN_COMPACT, KN_COMPRESS) == 0) && Reloaded(KN_FILE2, neurons));
+	Forget();
+	Check("KN_COMPACT compressed copied into the emulator",
+		(MapSimuKnowledge(KN_FILE2, 1) == 0) && (IsSimuKnowledgeMapped() == 0) && SameNeurons(neurons, Neurons()));
+
+	// compressed to uncompressed to KN_FORMAT gives back the same file
+	const char* converted = "Test_Knowledge_converted.knf";
+	const char* compact = "Test_Knowledge_converted.gvkn";
+	int error = ConvertKnowledge(KN_FILE2, compact, KN_COMPACT, 0);
+	if (error == 0) error = ConvertKnowledge(compact, converted, KN_FORMAT, 0);
+	Check("Knowledge converted across the formats", (error == 0) && SameFiles(KN_FILE, converted) && Reloaded(compact, neurons));
+	Check("Conversion to an unknown format rejected", ConvertKnowledge(KN_FILE, converted, 3, 0) == KN_ERROR_FORMAT);
+	remove(converted);
+	remove(compact);
+
+	// a changed model or register fails the checksums, a short file is truncated
+	Corrupt(KN_FILE2, 5);
+	Check("Corrupted compressed model detected", LoadKnowledge(KN_FILE2) == KN_ERROR_CHECKSUM);
+	SaveKnowledge(KN_FILE2, KN_COMPACT, 0);
+	Corrupt(KN_FILE2, 5);
+	Check("Corrupted model detected", LoadKnowledge(KN_FILE2) == KN_ERROR_CHECKSUM);
+	SaveKnowledge(KN_FILE2, KN_COMPACT, 0);
+	Corrupt(KN_FILE2, (long)(neurons.size() * NM_NEURONSIZE) + KN_ALIGN - KN_HEADERSIZE - 2);
+	Check("Corrupted register detected", LoadKnowledge(KN_FILE2) == KN_ERROR_CHECKSUM);
+	Truncate(KN_FILE, 16 + (10 * (NM_NEURONSIZE + 4) * 4) + 100);
+	Check("Truncated file detected", LoadKnowledge(KN_FILE) == KN_ERROR_TRUNCATED);
+	Check("Missing file detected", LoadKnowledge("Test_Knowledge.none") == KN_ERROR_OPEN);
+	remove(KN_FILE);
+	remove(KN_FILE2);
+}
+
+// --------------------------------------------------------------
+// CogniSight projects: settings, neurons and their MINIF and MAXIF
+// --------------------------------------------------------------
+static bool SameSettings(const ProjectSettings* a, const ProjectSettings* b)
+{
+	return((a->width == b->width) && (a->height == b->height) && (a->featID == b->featID) && (a->normalized == b->normalized)
+		&& (a->featParam1 == b->featParam1) && (a->featParam2 == b->featParam2) && (a->minif == b->minif) && (a->maxif == b->maxif));
+}
+
+static bool NetworkIF(int minif, int maxif)
+{
+	int context, networkMinif, networkMaxif;
+	getContext(&context, &networkMinif, &networkMaxif);
+	return((networkMinif == minif) && (networkMaxif == maxif));
+}
+
+static void TestProject()
+{
+	Forget();
+	std::vector<unsigned char> learned;
+	LearnVectors(100, true, learned);
+	std::vector<NeuronRecord> neurons = Neurons();
+	setContext(1, 6, 0x1200);
+	ProjectSettings settings = { 64, 48, 3, 1, 8, 6, 0, 0 }, loaded;
+	Check("Project saved", SaveProject(CSP_FILE, &settings) == 0);
+	settings.minif = 6;
+	settings.maxif = 0x1200;
+
+	Forget();
+	setContext(1, DEFMINIF, DEFMAXIF);
+	Check("Project loaded", (LoadProject(CSP_FILE, &loaded) == 0) && SameNeurons(neurons, Neurons()));
+	Check("Project settings", SameSettings(&settings, &loaded) && NetworkIF(6, 0x1200));
+
+	// the same project written by an AVR board, with 2-byte ints
+	FILE* f = fopen(CSP_FILE, "rb");
+	unsigned char records[9 * 4];
+	bool written = (f != NULL) && (fread(records, 1, sizeof(records), f) == sizeof(records));
+	if (f != NULL) fclose(f);
+	f = written ? fopen(CSP_FILE, "wb") : NULL;
+	written = (f != NULL) && (fwrite(records, 1, sizeof(records), f) == sizeof(records)) && PutRecords(f, neurons, 2);
+	if ((f != NULL) && (fclose(f) != 0)) written = false;
+	Forget();
+	Check("Project of 2-byte ints loaded", written && (LoadProject(CSP_FILE, &loaded) == 0) && SameNeurons(neurons, Neurons())
+		&& SameSettings(&settings, &loaded));
+
+	// a network too small for the project keeps its MINIF and MAXIF
+	SaveProject(CSP_FILE, &settings);
+	SetSimuNeurons(64);
+	InitializeNetwork();
+	setContext(1, DEFMINIF, DEFMAXIF);
+	Check("Project over capacity rejected", (LoadProject(CSP_FILE, &loaded) == KN_ERROR_CAPACITY) && NetworkIF(DEFMINIF, DEFMAXIF));
+	SetSimuNeurons(1024);
+	InitializeNetwork();
+	remove(CSP_FILE);
+}
+
+// --------------------------------------------------------------
+// Learn with a journal and two snapshots, then lose the process and
+// the device: the last snapshot and the journal restore the network
+// --------------------------------------------------------------
+#define SN_FILE		"Test_Knowledge.gvsn"
+#define JN_FILE		"Test_Knowledge.gvjn"
+
+static void TestRecovery()
+{
+	remove(SN_FILE);
+	remove(JN_FILE);
+	Forget();
+	SnapshotLog log;
+	LearningJournal journal;
+	int error = SnapshotOpen(&log, SN_FILE);
+	if (error == 0) error = JournalOpen(&journal, JN_FILE, 16, 100);
+	Check("Snapshot log and journal created", error == 0);
+	if (error != 0) return;
+	SetLearningJournal(&journal);
+
+	std::vector<unsigned char> learned;
+	LearnVectors(64, false, learned);
+	Check("Base snapshot", SaveSnapshot(&log, 0) == 0);
+	LearnVectors(48, true, learned);
+	Check("Incremental snapshot", SaveSnapshot(&log, 0) == 0);
+	Check("Journal emptied by the snapshot", journal.records == 0);
+	std::vector<NeuronRecord> snapshot = Neurons();
+
+	// learnings of the journal only, with a change of context and a Forget
+	LearnVectors(24, false, learned);
+	setContext(2, DEFMINIF, 0x2000);
+	LearnVectors(40, true, learned);
+	Forget();
+	LearnVectors(16, true, learned);
+	setContext(3, 8, 0x1000);
+	LearnVectors(20, false, learned);
+	JournalSync(&journal);
+	std::vector<NeuronRecord> before = Neurons();
+	long long records = journal.records;
+
+	// crash: the structures are lost, a record is torn and the device reset
+	SetLearningJournal(NULL);
+	SnapshotLog lostLog = log;
+	LearningJournal lostJournal = journal;
+	FILE* f = fopen(JN_FILE, "ab");
+	if (f != NULL)
+	{
+		unsigned char torn[JN_RECORDSIZE + 4];
+		RandomVector(torn, sizeof(torn));
+		torn[0] = JN_LEARN;
+		fwrite(torn, 1, sizeof(torn), f);
+		fclose(f);
+	}
+	InitializeNetwork();
+	Check("Network reset", GetCommitted() == 0);
+
+	error = SnapshotOpen(&log, SN_FILE);
+	if (error == 0) error = JournalOpen(&journal, JN_FILE, 16, 100);
+	Check("Torn record ignored by the journal", (error == 0) && (journal.records == records));
+	RecoveryStats stats;
+	if (error == 0) error = RecoverLearning(&log, &journal, &stats);
+	std::vector<NeuronRecord> after = Neurons();
+	Check("Learning recovered", (error == 0) && (stats.restored == (int)snapshot.size()) && (stats.replayed == records));
+	Check("Recovered neurons", SameNeurons(before, after));
+	SnapshotClose(&lostLog);
+	JournalClose(&lostJournal);
+
+	Check("Snapshot log compacted", SnapshotCompact(&log) == 0);
+	Check("Compacted snapshot loaded", (LoadSnapshot(&log) == 0) && SameNeurons(snapshot, Neurons()));
+	Check("Learning recovered from the compacted log", (RecoverLearning(&log, &journal, &stats) == 0) && SameNeurons(before, Neurons()));
+
+	SnapshotClose(&log);
+	JournalClose(&journal);
+	remove(SN_FILE);
+	remove(JN_FILE);
+}
+
+int main()
+{
+	int navail = InitializeNetwork();
+	if (navail == 0)
+	{
+		printf("Did not detect the NeuroMem platform!");
+		return -1;
+	}
+	printf("\nAvailable neurons: \t%u", navail);
+	TestCodec();
+	TestKnowledgeFiles();
+	TestProject();
+	TestRecovery();
+	printf("\n\n%d failure(s)\n", failures);
+	return(failures);
+}
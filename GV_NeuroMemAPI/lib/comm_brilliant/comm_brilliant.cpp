@@ -4,7 +4,9 @@
 
 //#include "stdafx.h"
 #include <Windows.h>
+#include "stdlib.h"	 //for calloc
 #include "CyAPI.h"
+#include "../neuromem/GV_comm.h"
 
 int platform = 2; //0=Simu,  1=Neuroshield,  2=Brilliant
 int maxveclength = 256; // length of the neuron memory on the Brilliant platform
@@ -20,6 +22,7 @@ byte wbuffer[USB_BUFF_LENGTH], rbuffer[USB_BUFF_LENGTH];
 //-----------------------------------------------
 int Connect(int device)
 {
+	CommRecord(COMM_CONNECT, device, 0, NULL, CommClock(), 0);
 	int error = 1;
 	int devnum = usbHandle->DeviceCount();
 	for (byte d = 0; d < devnum; d++)
@@ -46,6 +49,14 @@ int Disconnect()
 	return(0);
 }
 
+//-----------------------------------------------
+// Report if the last bulk transfer timed out
+//-----------------------------------------------
+static int USB_Timeout()
+{
+	return((usbHandle->BulkOutEndPt->LastError == ERROR_SEM_TIMEOUT) || (usbHandle->BulkInEndPt->LastError == ERROR_SEM_TIMEOUT));
+}
+
 //---------------------------------------------
 // Generic USB Read command
 //---------------------------------------------
@@ -56,6 +67,7 @@ int Read_Addr(int addr, int length_inByte, byte data[])
 
 	if (length_inByte > USB_BUFF_LENGTH) length_inByte = USB_BUFF_LENGTH;
 
+	long long t0 = CommClock();
 	int error = 0;
 	int len = length_inByte / 2; // used in the send-buff packet
 
@@ -71,8 +83,8 @@ int Read_Addr(int addr, int length_inByte, byte data[])
 	wbuffer[6] = (byte)((len & 0x0000FF00) >> 8);
 	wbuffer[7] = (byte)(len & 0x000000FF);
 
-	usbHandle->BulkOutEndPt->XferData(wbuffer, USB_buffLength, NULL, false);
-	usbHandle->BulkInEndPt->XferData(rbuffer, USB_buffLength, NULL, true);
+	bool xferOk = usbHandle->BulkOutEndPt->XferData(wbuffer, USB_buffLength, NULL, false);
+	xferOk &= usbHandle->BulkInEndPt->XferData(rbuffer, USB_buffLength, NULL, true);
 
 	if (USB_buffLength != USB_BUFF_LENGTH)
 	{
@@ -82,6 +94,9 @@ int Read_Addr(int addr, int length_inByte, byte data[])
 	{
 		memcpy(data, rbuffer, length_inByte);
 	}
+	// one packet out with the header, one packet back with the data
+	CommStatsRecord(COMM_READADDR, t0, length_inByte, 8, (2 * USB_BUFF_LENGTH) - 8 - length_inByte, error | !xferOk, USB_Timeout());
+	CommRecord(COMM_READADDR, addr, length_inByte, rbuffer, t0, error | !xferOk);
 
 	return(error);
 }
@@ -98,8 +113,10 @@ int Write_Addr(int addr, int length_inByte, byte data[])
 	int lenB = length_inByte;
 	if (length_inByte > USB_BUFF_LENGTH - 8) lenB = USB_BUFF_LENGTH - 8;
 
+	long long t0 = CommClock();
 	int error = 0;
 	int lenW = lenB / 2;
+	int packets = 1;
 
 	memset(wbuffer, 0x00, USB_BUFF_LENGTH);
 
@@ -138,20 +155,84 @@ int Write_Addr(int addr, int length_inByte, byte data[])
 		memcpy(wbuffer + 8, data + lenB, lenB2);
 		USB_buffLength = USB_BUFF_LENGTH;
 		usbHandle->BulkOutEndPt->XferData(wbuffer, USB_buffLength, NULL, false);
+		packets = 2;
 		if (USB_buffLength != USB_BUFF_LENGTH)
 		{
 			error = 2;
 		}
 	}
+	// data past the 2 packets is not sent
+	int sent = packets * (USB_BUFF_LENGTH - 8);
+	if (sent > length_inByte) sent = length_inByte;
+	CommStatsRecord(COMM_WRITEADDR, t0, sent, packets * 8, (packets * (USB_BUFF_LENGTH - 8)) - sent, error, USB_Timeout());
+	CommRecord(COMM_WRITEADDR, addr, length_inByte, data, t0, error);
 
 	return(error);
 }
 
+//-----------------------------------------------------
+// Write of 8-bit data, expanded to words in the packet buffer
+// split into packets of up to 252 words as in Write_Addr
+//-----------------------------------------------------
+int Write_AddrBytes(int addr, int length, const unsigned char bytes[])
+{
+	if (length < 1) return(0);
+	long long t0 = CommClock();
+	int error = 0;
+	int packets = 0;
+	int sent = 0;
+	do
+	{
+		int lenW = length - sent;
+		if (lenW > (USB_BUFF_LENGTH - 8) / 2) lenW = (USB_BUFF_LENGTH - 8) / 2;
+
+		wbuffer[0] = 1; // settings from nepes
+		wbuffer[1] = 0x80 + (byte)((addr & 0xFF000000) >> 24);
+		wbuffer[2] = (byte)((addr & 0x00FF0000) >> 16);
+		wbuffer[3] = (byte)((addr & 0x0000FF00) >> 8);
+		wbuffer[4] = (byte)(addr & 0x000000FF);
+		wbuffer[5] = (byte)((lenW & 0x00FF0000) >> 16);
+		wbuffer[6] = (byte)((lenW & 0x0000FF00) >> 8);
+		wbuffer[7] = (byte)(lenW & 0x000000FF);
+		for (int i = 0; i < lenW; i++)
+		{
+			wbuffer[8 + (i * 2)] = 0;
+			wbuffer[9 + (i * 2)] = bytes[sent + i];
+		}
+		// no bytes of a previous command are left past lenW words
+		memset(wbuffer + 8 + (lenW * 2), 0, USB_BUFF_LENGTH - 8 - (lenW * 2));
+		USB_buffLength = USB_BUFF_LENGTH;
+		usbHandle->BulkOutEndPt->XferData(wbuffer, USB_buffLength, NULL, false);
+		packets++;
+		sent += lenW;
+		if (USB_buffLength != USB_BUFF_LENGTH)
+		{
+			error = packets;
+			break;
+		}
+	} while (sent < length);
+	CommStatsRecord(COMM_WRITEADDR, t0, length * 2, packets * 8, (packets * (USB_BUFF_LENGTH - 8)) - (length * 2), error, USB_Timeout());
+	if (packets == 1) CommRecord(COMM_WRITEADDR, addr, length * 2, wbuffer + 8, t0, error);
+	else
+	{
+		// the whole write as sent over the packets
+		byte* expanded = (byte*)calloc(length, 2);
+		if (expanded != NULL)
+		{
+			for (int i = 0; i < length; i++) expanded[(i * 2) + 1] = bytes[i];
+			CommRecord(COMM_WRITEADDR, addr, length * 2, expanded, t0, error);
+			free(expanded);
+		}
+	}
+	return(error);
+}
+
 // --------------------------------------------------------
 // Read the register of a given module (module + reg = addr)
 //---------------------------------------------------------
 int Read(byte module, byte reg)
 {
+	long long t0 = CommClock();
 	memset(wbuffer, 0x00, USB_BUFF_LENGTH);
 	memset(rbuffer, 0x00, USB_BUFF_LENGTH);
 
@@ -164,9 +245,11 @@ int Read(byte module, byte reg)
 	wbuffer[6] = 0;
 	wbuffer[7] = 1;
 
-	usbHandle->BulkOutEndPt->XferData(wbuffer, USB_buffLength, NULL, false);
-	usbHandle->BulkInEndPt->XferData(rbuffer, USB_buffLength, NULL, true);
+	bool xferOk = usbHandle->BulkOutEndPt->XferData(wbuffer, USB_buffLength, NULL, false);
+	xferOk &= usbHandle->BulkInEndPt->XferData(rbuffer, USB_buffLength, NULL, true);
 	int data = (rbuffer[0] << 8) + rbuffer[1];
+	CommStatsRecord(COMM_READ, t0, 2, 8, (2 * USB_BUFF_LENGTH) - 10, !xferOk, USB_Timeout());
+	CommRecord(COMM_READ, (module << 24) + reg, 2, rbuffer, t0, !xferOk);
 
 	return(data);
 }
@@ -175,6 +258,7 @@ int Read(byte module, byte reg)
 // ---------------------------------------------------------
 void Write(byte module, byte reg, int data)
 {
+	long long t0 = CommClock();
 	memset(wbuffer, 0x00, USB_BUFF_LENGTH);
 
 	wbuffer[0] = 1; // settings from nepes
@@ -188,5 +272,61 @@ void Write(byte module, byte reg, int data)
 	wbuffer[8] = (byte)((data >> 8) & 0x00ff);
 	wbuffer[9] = (byte)(data & 0x00ff);
 
-	usbHandle->BulkOutEndPt->XferData(wbuffer, USB_buffLength, NULL, false);
+	bool xferOk = usbHandle->BulkOutEndPt->XferData(wbuffer, USB_buffLength, NULL, false);
+	CommStatsRecord(COMM_WRITE, t0, 2, 8, USB_BUFF_LENGTH - 10, !xferOk, USB_Timeout());
+	CommRecord(COMM_WRITE, (module << 24) + reg, 2, wbuffer + 8, t0, !xferOk);
+}
+
+// ---------------------------------------------------------
+// Several write commands in one bulk transfer
+// Each command is re-packed into its own packet(s) as in Write_Addr,
+// and all the packets are sent with a single XferData; the buffer of
+// the packets is kept between calls
+// ---------------------------------------------------------
+static byte* framesPackets = NULL;
+static int framesPacketsCount = 0;
+
+int Write_Frames(unsigned char frames[], int length_inByte)
+{
+	long long t0 = CommClock();
+	// worst case of one packet per 2-byte command
+	int maxPackets = (length_inByte / 10) + (length_inByte / (USB_BUFF_LENGTH - 8)) + 1;
+	if (maxPackets > framesPacketsCount)
+	{
+		byte* grown = (byte*)realloc(framesPackets, (size_t)maxPackets * USB_BUFF_LENGTH);
+		if (grown == NULL) return(1);
+		framesPackets = grown;
+		framesPacketsCount = maxPackets;
+	}
+	byte* packets = framesPackets;
+	int count = 0, payload = 0;
+	for (int pos = 0; pos + 8 <= length_inByte; )
+	{
+		const byte* frame = frames + pos;
+		int lenB = 2 * ((frame[5] << 16) + (frame[6] << 8) + frame[7]);
+		const byte* data = frame + 8;
+		pos += 8 + lenB;
+		payload += lenB;
+		do
+		{
+			int chunk = lenB > USB_BUFF_LENGTH - 8 ? USB_BUFF_LENGTH - 8 : lenB;
+			int lenW = chunk / 2;
+			byte* packet = packets + (count++ * USB_BUFF_LENGTH);
+			memcpy(packet, frame, 5); // board, module and address
+			packet[5] = (byte)((lenW & 0x00FF0000) >> 16);
+			packet[6] = (byte)((lenW & 0x0000FF00) >> 8);
+			packet[7] = (byte)(lenW & 0x000000FF);
+			memcpy(packet + 8, data, chunk);
+			memset(packet + 8 + chunk, 0, USB_BUFF_LENGTH - 8 - chunk);
+			data += chunk;
+			lenB -= chunk;
+		} while (lenB > 0);
+	}
+	LONG xferLength = count * USB_BUFF_LENGTH;
+	bool xferOk = usbHandle->BulkOutEndPt->XferData(packets, xferLength, NULL, false);
+	int error = (!xferOk || (xferLength != count * USB_BUFF_LENGTH)) ? 1 : 0;
+
+	CommStatsRecord(COMM_WRITEFRAMES, t0, payload, count * 8, count * (USB_BUFF_LENGTH - 8) - payload, error, USB_Timeout());
+	CommRecord(COMM_WRITEFRAMES, 0, length_inByte, frames, t0, error);
+	return(error);
 }
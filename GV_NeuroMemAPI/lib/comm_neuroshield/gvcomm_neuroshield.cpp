@@ -8,6 +8,7 @@
 #include "stdio.h" // printf
 
 #include "CyUSBSerial.h"
+#include "../neuromem/GV_comm.h"
 #define NM500_SPI_CLK_DIV	SPI_CLOCK_DIV8	// spi clock : 16MHz / 8 = 2MHz
 #define NM500_SPI_CLK		2000000
 
@@ -78,6 +79,7 @@ int FindDeviceAtSCB1()
 int Connect(int DeviceID)
 {
 	// DeviceID is presently ignored
+	CommRecord(COMM_CONNECT, DeviceID, 0, NULL, CommClock(), 0);
 
 	// Assmumptions:
 	// 1. SCB1 is configured as SPI
@@ -109,9 +111,9 @@ int Disconnect()
 }
 
 //-----------------------------------------------------
-// Generic USB Write command
+// SPI Write transfer, shared by Write_Addr and Write
 //-----------------------------------------------------
-int Write_Addr(int addr, int length_inByte, byte data[])
+static int SPI_Write(int addr, int length_inByte, byte data[])
 {
 	//The USB controller in the FPGA expect data length in word
 	int len = length_inByte / 2;	
@@ -152,10 +154,60 @@ int Write_Addr(int addr, int length_inByte, byte data[])
 	
 }
 
+//-----------------------------------------------------
+// Generic USB Write command
+//-----------------------------------------------------
+int Write_Addr(int addr, int length_inByte, byte data[])
+{
+	long long t0 = CommClock();
+	int error = SPI_Write(addr, length_inByte, data);
+	CommStatsRecord(COMM_WRITEADDR, t0, length_inByte, 8, 0, error, rStatus == CY_ERROR_IO_TIMEOUT);
+	CommRecord(COMM_WRITEADDR, addr, length_inByte, data, t0, error);
+	return(error);
+}
+
+//-----------------------------------------------------
+// Write of 8-bit data, expanded to words in the SPI buffer
+// which holds up to 256 words
+//-----------------------------------------------------
+int Write_AddrBytes(int addr, int length, const unsigned char bytes[])
+{
+	if (length < 1) return(0);
+	if (length > (int)(sizeof(wbuffer) - 8) / 2) return(1);
+	long long t0 = CommClock();
+	uint16_t total_size = 8 + (length * 2);
+
+	cyDatabufferWrite.buffer = wbuffer;
+	cyDatabufferWrite.length = total_size;
+
+	cyDatabufferRead.buffer = rbuffer;
+	cyDatabufferRead.length = total_size;
+
+	wbuffer[0] = 1; //reserved for a board number
+	int module = (byte)((addr & 0xFF000000) >> 24);
+	wbuffer[1] = module + 0x80;
+	wbuffer[2] = (byte)((addr & 0x00FF0000) >> 16);
+	wbuffer[3] = (byte)((addr & 0x0000FF00) >> 8);
+	wbuffer[4] = (byte)(addr & 0x000000FF);
+	wbuffer[5] = (byte)((length & 0x00FF0000) >> 16);
+	wbuffer[6] = (byte)((length & 0x0000FF00) >> 8);
+	wbuffer[7] = (byte)(length & 0x000000FF);
+	for (int i = 0; i < length; i++) {
+		wbuffer[8 + (i * 2)] = 0;
+		wbuffer[9 + (i * 2)] = bytes[i];
+	}
+
+	rStatus = CySpiReadWrite(cyHandle, &cyDatabufferRead, &cyDatabufferWrite, 5000);
+	int error = (rStatus != CY_SUCCESS) ? 1 : 0;
+	CommStatsRecord(COMM_WRITEADDR, t0, length * 2, 8, 0, error, rStatus == CY_ERROR_IO_TIMEOUT);
+	CommRecord(COMM_WRITEADDR, addr, length * 2, wbuffer + 8, t0, error);
+	return(error);
+}
+
 //---------------------------------------------
-// Generic USB Read command
+// SPI Read transfer, shared by Read_Addr and Read
 //---------------------------------------------
-int Read_Addr(int addr, int length_inByte, byte data[])
+static int SPI_Read(int addr, int length_inByte, byte data[])
 {
 	int len = length_inByte / 2;
 	uint16_t total_size = 8 + length_inByte;
@@ -199,16 +251,31 @@ int Read_Addr(int addr, int length_inByte, byte data[])
 	return(error);
 }
 
+//---------------------------------------------
+// Generic USB Read command
+//---------------------------------------------
+int Read_Addr(int addr, int length_inByte, byte data[])
+{
+	long long t0 = CommClock();
+	int error = SPI_Read(addr, length_inByte, data);
+	CommStatsRecord(COMM_READADDR, t0, length_inByte, 8, 0, error, rStatus == CY_ERROR_IO_TIMEOUT);
+	CommRecord(COMM_READADDR, addr, length_inByte, data, t0, error);
+	return(error);
+}
+
 // --------------------------------------------------------
 // Read the register of a given module (module + reg = addr)
 //---------------------------------------------------------
 int Read(byte module, byte reg)
 {
+	long long t0 = CommClock();
 	int data = 0xFFFF;
 	int addr = (module << 24) + reg;
-	byte databyte[2];
-	int error = Read_Addr(addr, 2, databyte);
+	byte databyte[2] = { 0, 0 };
+	int error = SPI_Read(addr, 2, databyte);
 	if (error == 0) data = (databyte[0] << 8) + databyte[1];
+	CommStatsRecord(COMM_READ, t0, 2, 8, 0, error, rStatus == CY_ERROR_IO_TIMEOUT);
+	CommRecord(COMM_READ, addr, 2, databyte, t0, error);
 	return(data);
 }
 // ---------------------------------------------------------
@@ -216,9 +283,57 @@ int Read(byte module, byte reg)
 // ---------------------------------------------------------
 void Write(byte module, byte reg, int data)
 {
+	long long t0 = CommClock();
 	byte databyte[2];
 	databyte[1] = (byte)(data & 0x00FF);
 	databyte[0] = (byte)((data & 0xFF00) >> 8);
 	int addr = (module << 24) + reg;
-	int error = Write_Addr(addr, 2, databyte);
+	int error = SPI_Write(addr, 2, databyte);
+	CommStatsRecord(COMM_WRITE, t0, 2, 8, 0, error, rStatus == CY_ERROR_IO_TIMEOUT);
+	CommRecord(COMM_WRITE, addr, 2, databyte, t0, error);
+}
+
+// ---------------------------------------------------------
+// Several write commands, each one clocked in its own SPI transfer
+// as Write_Addr does, the commands are not sent under a single chip
+// select; the buffer receiving the bytes clocked back is kept between calls
+// ---------------------------------------------------------
+static unsigned char* framesReadback = NULL;
+static int framesReadbackLength = 0;
+
+int Write_Frames(unsigned char frames[], int length_inByte)
+{
+	long long t0 = CommClock();
+	int error = 0;
+	int pos = 0;
+	// one SPI transfer per command, each recorded as a transaction
+	while ((pos + 8 <= length_inByte) && (error == 0))
+	{
+		long long tf = CommClock();
+		int frameBytes = 8 + 2 * ((frames[pos + 5] << 16) + (frames[pos + 6] << 8) + frames[pos + 7]);
+		if (pos + frameBytes > length_inByte) frameBytes = length_inByte - pos;
+		if (frameBytes > framesReadbackLength)
+		{
+			unsigned char* readback = (unsigned char*)realloc(framesReadback, frameBytes);
+			if (readback == NULL)
+			{
+				error = 1;
+				CommStatsRecord(COMM_WRITEFRAMES, tf, 0, 0, 0, error, 0);
+				break;
+			}
+			framesReadback = readback;
+			framesReadbackLength = frameBytes;
+		}
+		CY_DATA_BUFFER framesWrite, framesRead;
+		framesWrite.buffer = frames + pos;
+		framesWrite.length = frameBytes;
+		framesRead.buffer = framesReadback;
+		framesRead.length = frameBytes;
+		rStatus = CySpiReadWrite(cyHandle, &framesRead, &framesWrite, 5000);
+		if (rStatus != CY_SUCCESS) error = 1;
+		CommStatsRecord(COMM_WRITEFRAMES, tf, frameBytes - 8, 8, 0, error, rStatus == CY_ERROR_IO_TIMEOUT);
+		pos += frameBytes;
+	}
+	CommRecord(COMM_WRITEFRAMES, 0, length_inByte, frames, t0, error);
+	return(error);
 }
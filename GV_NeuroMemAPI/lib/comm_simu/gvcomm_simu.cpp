@@ -0,0 +1,728 @@
+// gvcomm_simu.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Software emulation of a NeuroMem network behind the R/W functions
+// declared in GV_comm.h
+//
+// The neuron registers behave as described in the NM500 datasheet:
+// - Normal mode: COMP/LCOMP broadcast a vector, DIST/CAT/NID read the
+//   firing neurons by increasing distance, CAT writes learn the vector
+// - Save and Restore mode (NSR bit 4): the registers access the neuron
+//   pointed by the chain, a CAT access moves the chain to the next neuron
+//
+#include "stdlib.h"	 //for calloc
+#include "string.h"  //for memset
+#include <vector>
+#include <algorithm>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "../neuromem/GV_comm.h"
+#include "../neuromem/NeuroMemKnowledge.h"
+#include "gvcomm_simu.h"
+
+int platform = 0; //0=Simu,  1=Neuroshield,  2=Brilliant
+int maxveclength = 256; // length of the neuron memory of the NM500
+
+#define SIMU_NSR_SR		0x10
+#define SIMU_NSR_KNN	0x20
+#define SIMU_NSR_UNC	0x04
+#define SIMU_NSR_ID		0x08
+
+typedef struct
+{
+	unsigned short ncr;
+	unsigned short aif;
+	unsigned short minif;
+	unsigned short cat;
+} SimuNeuron;
+
+static int simuNeurons = SIMU_DEFNEURONS;	// requested capacity
+static int navail = 0;						// capacity of the connected network
+static unsigned char* models = NULL;		// navail * maxveclength components
+static SimuNeuron* neurons = NULL;
+static int* dists = NULL;
+static size_t mappedModels = 0;				// lengths of the store mapped from a file, 0 if allocated
+static size_t mappedRegisters = 0;
+static unsigned char* mappedBase = NULL;	// start of the register mapping
+
+static int ncount = 0;
+static int gcr = DEFGCR, minif = DEFMINIF, maxif = DEFMAXIF;
+static int nsr = 0;
+static int compIndex = 0;		// index of the next component read or written
+static int chainIndex = 0;		// neuron pointed in Save and Restore mode
+static int vectorLength = 0;	// length of the last broadcast vector
+static unsigned char input[256];	// last broadcast vector
+static std::vector<int> firing;	// firing neurons sorted by distance
+static int readIndex = 0;		// next firing neuron returned by DIST
+static int current = -1;		// firing neuron last returned by DIST
+
+static bool timingOn = false;
+static SimuTiming timing;
+static unsigned long long deviceNs = 0;
+
+void SetSimuNeurons(int count)
+{
+	if (count < 1) count = 1;
+	if (count > SIMU_MAXNEURONS) count = SIMU_MAXNEURONS;
+	simuNeurons = count;
+}
+
+int GetSimuNeurons()
+{
+	return(simuNeurons);
+}
+
+//-----------------------------------------------
+// Timing presets of the supported platforms
+//-----------------------------------------------
+void GetSimuTimingPreset(int preset, SimuTiming* t)
+{
+	memset(t, 0, sizeof(SimuTiming));
+	switch (preset)
+	{
+	case SIMU_TIMING_NEUROSHIELD:
+		t->platform = 1;
+		t->clockHz = 2000000;
+		t->fullDuplex = 1;
+		t->transactionNs = 1000000; // one USB full-speed frame per CySpiReadWrite
+		t->recognitionNs = 10000;
+		break;
+	case SIMU_TIMING_BRAINCARD:
+		t->platform = 1;
+		t->clockHz = 4000000;
+		t->fullDuplex = 1;
+		t->transactionNs = 5000; // chip select and SPI.beginTransaction
+		t->recognitionNs = 10000;
+		break;
+	case SIMU_TIMING_BRILLIANT:
+		t->platform = 2;
+		t->clockHz = 480000000;
+		t->packetBytes = 512;
+		t->transactionNs = 125000; // one USB high-speed microframe
+		t->recognitionNs = 10000;
+		break;
+	}
+}
+
+void SetSimuTiming(const SimuTiming* t)
+{
+	timingOn = (t != NULL);
+	if (timingOn) timing = *t;
+	platform = timingOn ? timing.platform : 0;
+}
+
+unsigned long long GetSimuDeviceNs()
+{
+	return(deviceNs);
+}
+
+void ResetSimuDeviceNs()
+{
+	deviceNs = 0;
+}
+
+//-----------------------------------------------
+// Time of a transaction on the modelled bus
+// and split of its bytes into header and padding
+//-----------------------------------------------
+static void SimuBusTime(bool isRead, int payloadBytes, int* paddingBytes)
+{
+	*paddingBytes = 0;
+	if (!timingOn) return;
+	long long bytes;
+	if (timing.packetBytes > 0)
+	{
+		// command packet(s) out, data packet(s) back for a read
+		long long outBytes = isRead ? 8 : 8 + payloadBytes;
+		long long packets = (outBytes + timing.packetBytes - 1) / timing.packetBytes;
+		if (isRead) packets += (payloadBytes + timing.packetBytes - 1) / timing.packetBytes;
+		bytes = packets * timing.packetBytes;
+		*paddingBytes = (int)(bytes - 8 - payloadBytes);
+	}
+	else if (isRead && !timing.fullDuplex) bytes = 8 + (2 * (long long)payloadBytes);
+	else bytes = 8 + payloadBytes;
+	deviceNs += timing.transactionNs + (bytes * 8 * 1000000000LL) / timing.clockHz;
+}
+
+// several write commands, one transfer per command on a serial bus,
+// or one transfer of the commands padded to whole packets on a packet bus
+static void SimuFramesTime(const unsigned char frames[], int length_inByte, int* headerBytes, int* paddingBytes)
+{
+	*headerBytes = 0;
+	*paddingBytes = 0;
+	long long packets = 0;
+	for (int pos = 0; pos + 8 <= length_inByte; )
+	{
+		int frameBytes = 8 + 2 * ((frames[pos + 5] << 16) + (frames[pos + 6] << 8) + frames[pos + 7]);
+		*headerBytes += 8;
+		if (timingOn && (timing.packetBytes > 0)) packets += (frameBytes + timing.packetBytes - 1) / timing.packetBytes;
+		pos += frameBytes;
+	}
+	if (!timingOn) return;
+	long long bytes = length_inByte;
+	long long transactions = *headerBytes / 8; // one SPI transfer per command
+	if (timing.packetBytes > 0)
+	{
+		// the packets of all the commands in one bulk transfer
+		bytes = packets * timing.packetBytes;
+		*paddingBytes = (int)(bytes - length_inByte);
+		transactions = 1;
+	}
+	deviceNs += (transactions * timing.transactionNs) + (bytes * 8 * 1000000000LL) / timing.clockHz;
+}
+
+//-----------------------------------------------
+// Uncommit all the neurons and reset the global registers
+//-----------------------------------------------
+static void SimuForget()
+{
+	ncount = 0;
+	for (int i = 0; i < navail; i++)
+	{
+		neurons[i].cat = 0;
+		neurons[i].aif = DEFMAXIF;
+		neurons[i].minif = DEFMINIF;
+		neurons[i].ncr = DEFGCR;
+	}
+	gcr = DEFGCR; minif = DEFMINIF; maxif = DEFMAXIF;
+	compIndex = 0; chainIndex = 0; vectorLength = 0;
+	firing.clear(); readIndex = 0; current = -1;
+}
+
+//-----------------------------------------------
+// Allocate the network
+//-----------------------------------------------
+static void SimuFreeStore()
+{
+#ifndef _WIN32
+	if (mappedModels)
+	{
+		munmap(models, mappedModels);
+		munmap(mappedBase, mappedRegisters);
+		mappedModels = 0; mappedRegisters = 0; mappedBase = NULL;
+	}
+	else
+#endif
+	{
+		free(models); free(neurons);
+	}
+	models = NULL; neurons = NULL;
+}
+
+int Connect(int DeviceID)
+{
+	long long t0 = CommClock();
+	SimuFreeStore(); free(dists);
+	navail = simuNeurons;
+	models = (unsigned char*)calloc((size_t)navail * maxveclength, 1);
+	neurons = (SimuNeuron*)calloc(navail, sizeof(SimuNeuron));
+	dists = (int*)calloc(navail, sizeof(int));
+	int error = ((models == NULL) || (neurons == NULL) || (dists == NULL)) ? 1 : 0;
+	if (error) navail = 0;
+	nsr = 0;
+	SimuForget();
+	CommRecord(COMM_CONNECT, DeviceID, 0, NULL, t0, error);
+	return(error);
+}
+
+int Disconnect()
+{
+	SimuFreeStore(); free(dists);
+	dists = NULL;
+	navail = 0;
+	return(0);
+}
+
+//-----------------------------------------------
+// Knowledge mapped from a file
+//-----------------------------------------------
+// the neurons following the loaded ones are free
+static void SimuLoaded(int count)
+{
+	ncount = count;
+	for (int i = count; i < navail; i++)
+	{
+		neurons[i].cat = 0;
+		neurons[i].aif = DEFMAXIF;
+		neurons[i].minif = DEFMINIF;
+		neurons[i].ncr = DEFGCR;
+	}
+	compIndex = 0; chainIndex = 0;
+	firing.clear(); readIndex = 0; current = -1;
+}
+
+// copy of the records, for the files which cannot be mapped
+static int SimuCopyKnowledge(const char* filename)
+{
+	KnowledgeFile kn;
+	int error = KnowledgeOpen(&kn, filename);
+	if ((error == 0) && (kn.ncount > navail)) error = KN_ERROR_CAPACITY;
+	if (error)
+	{
+		KnowledgeClose(&kn);
+		return(error);
+	}
+	NeuronRecord* records = (NeuronRecord*)malloc(256 * sizeof(NeuronRecord));
+	int count = 0, got;
+	while ((got = KnowledgeRead(&kn, records, 256)) > 0)
+	{
+		for (int i = 0; i < got; i++, count++)
+		{
+			neurons[count].ncr = records[i].context;
+			neurons[count].aif = records[i].aif;
+			neurons[count].minif = records[i].minif;
+			neurons[count].cat = records[i].cat;
+			unsigned char* model = models + (size_t)count * maxveclength;
+			memcpy(model, records[i].model, kn.neuronSize);
+			memset(model + kn.neuronSize, 0, maxveclength - kn.neuronSize);
+		}
+	}
+	free(records);
+	SimuLoaded(count);
+	return(KnowledgeClose(&kn));
+}
+
+#ifndef _WIN32
+// clear the end of the last page of a file mapping, past the mapped section
+static void SimuClearTail(unsigned char* base, size_t used, size_t length, size_t page)
+{
+	size_t end = ((used + page - 1) / page) * page;
+	if (end > length) end = length;
+	if (end > used) memset(base + used, 0, end - used);
+}
+
+// the store is made of two private mappings of the file over anonymous
+// memory: the model section over the models of the network, and the start
+// of the file over the registers, the capacity beyond the file is free
+static int SimuMapStore(int fd, const KnowledgeHeader* h, size_t page)
+{
+	size_t modelBytes = (size_t)navail * maxveclength;
+	size_t regEnd = (size_t)(h->regOffset + h->regLength);
+	size_t regBytes = (((size_t)h->regOffset + (size_t)navail * sizeof(SimuNeuron) + page - 1) / page) * page;
+	unsigned char* m = (unsigned char*)mmap(NULL, modelBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	unsigned char* r = (unsigned char*)mmap(NULL, regBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	bool failed = (m == MAP_FAILED) || (r == MAP_FAILED);
+	if (!failed && (h->ncount > 0))
+	{
+		failed = (mmap(m, (size_t)h->modelLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, (off_t)h->modelOffset) == MAP_FAILED)
+			|| (mmap(r, regEnd, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED);
+	}
+	if (failed)
+	{
+		if (m != MAP_FAILED) munmap(m, modelBytes);
+		if (r != MAP_FAILED) munmap(r, regBytes);
+		return(1);
+	}
+	if (h->ncount > 0)
+	{
+		SimuClearTail(m, (size_t)h->modelLength, modelBytes, page);
+		SimuClearTail(r, regEnd, regBytes, page);
+	}
+	SimuFreeStore();
+	models = m;
+	neurons = (SimuNeuron*)(r + h->regOffset);
+	mappedModels = modelBytes; mappedRegisters = regBytes; mappedBase = r;
+	SimuLoaded(h->ncount);
+	return(0);
+}
+#endif
+
+int MapSimuKnowledge(const char* filename, int verify)
+{
+	if (navail == 0) return(KN_ERROR_CAPACITY);
+#ifndef _WIN32
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return(KN_ERROR_OPEN);
+	unsigned char header[KN_HEADERSIZE];
+	KnowledgeHeader h;
+	unsigned short one = 1;
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	struct stat st;
+	// the registers are used as is, little-endian like the SimuNeuron of the host
+	bool mappable = (*(unsigned char*)&one == 1) && (pread(fd, header, KN_HEADERSIZE, 0) == KN_HEADERSIZE)
+		&& (KnowledgeParseHeader(header, &h) == 0) && ((h.flags & KN_COMPRESS) == 0)
+		&& (h.neuronSize == maxveclength) && (h.modelOffset % page == 0) && (h.regOffset % 2 == 0);
+	int error = 0;
+	if (mappable)
+	{
+		if (h.ncount > navail) error = KN_ERROR_CAPACITY;
+		else if ((fstat(fd, &st) != 0) || ((unsigned long long)st.st_size < h.modelOffset + h.modelLength)) error = KN_ERROR_TRUNCATED;
+		else if (SimuMapStore(fd, &h, page) != 0) mappable = false;
+	}
+	close(fd);
+	if (error) return(error);
+	if (mappable)
+	{
+		if (verify && ((KnowledgeAdler32(1, (unsigned char*)neurons, (size_t)h.regLength) != h.regChecksum)
+			|| (KnowledgeAdler32(1, models, (size_t)h.modelLength) != h.modelChecksum)))
+		{
+			SimuForget();
+			return(KN_ERROR_CHECKSUM);
+		}
+		return(0);
+	}
+#endif
+	return(SimuCopyKnowledge(filename));
+}
+
+int IsSimuKnowledgeMapped()
+{
+	return(mappedModels ? 1 : 0);
+}
+
+//-----------------------------------------------
+// Distance between the broadcast vector and a model
+// L1 or LSup norm selected by bit 7 of GCR
+//-----------------------------------------------
+static int SimuDistance(const unsigned char* model)
+{
+	int dist = 0;
+	if (gcr & 0x80)
+	{
+		for (int i = 0; i < vectorLength; i++)
+		{
+			int d = abs((int)input[i] - (int)model[i]);
+			if (d > dist) dist = d;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < vectorLength; i++) dist += abs((int)input[i] - (int)model[i]);
+	}
+	return(dist > 0xFFFF ? 0xFFFF : dist);
+}
+
+// a neuron responds if its context matches the active one, context 0 selects all
+static bool SimuInContext(int n)
+{
+	int context = gcr & 0x7F;
+	return((context == 0) || ((neurons[n].ncr & 0x7F) == context));
+}
+
+//-----------------------------------------------
+// Compare the broadcast vector to the committed neurons
+// and sort the firing ones by distance, then category
+//-----------------------------------------------
+static void SimuRecognize()
+{
+	firing.clear();
+	for (int n = 0; n < ncount; n++)
+	{
+		if (!SimuInContext(n)) { dists[n] = 0xFFFF; continue; }
+		dists[n] = SimuDistance(models + (size_t)n * maxveclength);
+		if ((nsr & SIMU_NSR_KNN) || (dists[n] < neurons[n].aif)) firing.push_back(n);
+	}
+	std::sort(firing.begin(), firing.end(), [](int a, int b)
+	{
+		if (dists[a] != dists[b]) return(dists[a] < dists[b]);
+		if ((neurons[a].cat & 0x7FFF) != (neurons[b].cat & 0x7FFF)) return((neurons[a].cat & 0x7FFF) < (neurons[b].cat & 0x7FFF));
+		return(a < b);
+	});
+	nsr &= ~(SIMU_NSR_ID | SIMU_NSR_UNC);
+	if (firing.size() > 0)
+	{
+		int cat = neurons[firing[0]].cat & 0x7FFF;
+		nsr |= SIMU_NSR_ID;
+		for (size_t i = 1; i < firing.size(); i++)
+		{
+			if ((neurons[firing[i]].cat & 0x7FFF) != cat)
+			{
+				nsr = (nsr & ~SIMU_NSR_ID) | SIMU_NSR_UNC;
+				break;
+			}
+		}
+	}
+	readIndex = 0;
+	current = -1;
+}
+
+//-----------------------------------------------
+// Learn the broadcast vector with a category
+// the firing neurons of another category shrink their influence field,
+// a new neuron is committed unless one of the firing neurons has the category
+//-----------------------------------------------
+static void SimuLearn(int category)
+{
+	int newAif = maxif;
+	bool recognized = false;
+	for (int n = 0; n < ncount; n++)
+	{
+		if (!SimuInContext(n)) continue;
+		int cat = neurons[n].cat & 0x7FFF;
+		if (cat == category)
+		{
+			if (dists[n] < neurons[n].aif) recognized = true;
+			continue;
+		}
+		if (dists[n] < newAif) newAif = dists[n];
+		if (dists[n] < neurons[n].aif)
+		{
+			if (dists[n] <= neurons[n].minif)
+			{
+				neurons[n].aif = neurons[n].minif;
+				neurons[n].cat |= 0x8000; // degenerated
+			}
+			else neurons[n].aif = dists[n];
+		}
+	}
+	if ((category == 0) || recognized || (ncount >= navail)) return;
+	SimuNeuron* neuron = &neurons[ncount];
+	unsigned char* model = models + (size_t)ncount * maxveclength;
+	memcpy(model, input, vectorLength);
+	memset(model + vectorLength, 0, maxveclength - vectorLength);
+	neuron->ncr = gcr & 0xFF;
+	neuron->minif = minif;
+	neuron->cat = category;
+	if (newAif <= minif)
+	{
+		neuron->aif = minif;
+		neuron->cat |= 0x8000;
+	}
+	else neuron->aif = newAif;
+	dists[ncount] = 0;
+	ncount++;
+}
+
+//-----------------------------------------------
+// Register access
+//-----------------------------------------------
+static int SimuRead(unsigned char module, unsigned char reg)
+{
+	if ((module != MOD_NM) || (navail == 0)) return(0xFFFF);
+	if (nsr & SIMU_NSR_SR)
+	{
+		// Save and Restore mode, access to the neuron pointed by the chain
+		if (chainIndex >= navail) return(0xFFFF);
+		SimuNeuron* neuron = &neurons[chainIndex];
+		switch (reg)
+		{
+		case NM_NCR: return(neuron->ncr);
+		case NM_COMP:
+			if (compIndex >= maxveclength) return(0);
+			return(models[(size_t)chainIndex * maxveclength + compIndex++]);
+		case NM_AIF: return(neuron->aif);
+		case NM_MINIF: return(neuron->minif);
+		case NM_CAT:
+		{
+			int cat = neuron->cat;
+			chainIndex++;
+			compIndex = 0;
+			return(cat);
+		}
+		case NM_NID: return(chainIndex + 1);
+		case NM_MAXIF: return(maxif);
+		case NM_GCR: return(gcr);
+		case NM_NSR: return(nsr);
+		case NM_NCOUNT: return(ncount);
+		default: return(0);
+		}
+	}
+	switch (reg)
+	{
+	case NM_NCR: return(gcr);
+	case NM_DIST:
+		if (readIndex >= (int)firing.size())
+		{
+			current = -1;
+			return(0xFFFF);
+		}
+		current = firing[readIndex++];
+		return(dists[current]);
+	case NM_CAT:
+		if (current < 0)
+		{
+			if (firing.size() == 0) return(0xFFFF);
+			return(neurons[firing[0]].cat);
+		}
+		return(neurons[current].cat);
+	case NM_NID:
+		if (current < 0) return(firing.size() == 0 ? 0xFFFF : firing[0] + 1);
+		return(current + 1);
+	case NM_AIF: return(current < 0 ? 0xFFFF : neurons[current].aif);
+	case NM_MINIF: return(minif);
+	case NM_MAXIF: return(maxif);
+	case NM_GCR: return(gcr);
+	case NM_NSR: return(nsr);
+	case NM_NCOUNT: return(ncount);
+	default: return(0);
+	}
+}
+
+static void SimuWrite(unsigned char module, unsigned char reg, int data)
+{
+	if ((module != MOD_NM) || (navail == 0)) return;
+	data &= 0xFFFF;
+	switch (reg)
+	{
+	case NM_NSR: nsr = data & (SIMU_NSR_SR | SIMU_NSR_KNN); return;
+	case NM_FORGET: SimuForget(); return;
+	case NM_RESETCHAIN: chainIndex = 0; compIndex = 0; return;
+	case NM_INDEXCOMP: compIndex = data; return;
+	case NM_TESTCOMP:
+		if (compIndex < maxveclength)
+		{
+			for (int n = 0; n < navail; n++) models[(size_t)n * maxveclength + compIndex] = (unsigned char)data;
+			compIndex++;
+		}
+		return;
+	case NM_TESTCAT:
+		for (int n = 0; n < navail; n++) neurons[n].cat = data;
+		return;
+	case NM_GCR: gcr = data; return;
+	case NM_MAXIF: maxif = data; return;
+	}
+	if (nsr & SIMU_NSR_SR)
+	{
+		if (chainIndex >= navail) return;
+		SimuNeuron* neuron = &neurons[chainIndex];
+		switch (reg)
+		{
+		case NM_NCR: neuron->ncr = data; break;
+		case NM_COMP:
+			if (compIndex < maxveclength) models[(size_t)chainIndex * maxveclength + compIndex++] = (unsigned char)data;
+			break;
+		case NM_AIF: neuron->aif = data; break;
+		case NM_MINIF: neuron->minif = data; break;
+		case NM_CAT:
+			neuron->cat = data;
+			if ((data != 0) && (chainIndex >= ncount)) ncount = chainIndex + 1;
+			chainIndex++;
+			compIndex = 0;
+			break;
+		}
+		return;
+	}
+	switch (reg)
+	{
+	case NM_NCR: gcr = data; break;
+	case NM_COMP:
+		if (compIndex < maxveclength) input[compIndex++] = (unsigned char)data;
+		break;
+	case NM_LCOMP:
+		if (compIndex < maxveclength) input[compIndex++] = (unsigned char)data;
+		vectorLength = compIndex;
+		compIndex = 0;
+		SimuRecognize();
+		if (timingOn) deviceNs += timing.recognitionNs;
+		break;
+	case NM_MINIF: minif = data; break;
+	case NM_CAT:
+		SimuLearn(data & 0x7FFF);
+		if (timingOn) deviceNs += timing.recognitionNs;
+		break;
+	}
+}
+
+// --------------------------------------------------------
+// Read the register of a given module (module + reg = addr)
+//---------------------------------------------------------
+int Read(unsigned char module, unsigned char reg)
+{
+	long long t0 = CommClock();
+	int data = SimuRead(module, reg);
+	unsigned char databyte[2] = { (unsigned char)(data >> 8), (unsigned char)(data & 0xFF) };
+	int padding;
+	SimuBusTime(true, 2, &padding);
+	CommStatsRecord(COMM_READ, t0, 2, 8, padding, 0, 0);
+	CommRecord(COMM_READ, (module << 24) + reg, 2, databyte, t0, 0);
+	return(data);
+}
+// ---------------------------------------------------------
+// Write the register of a given module (module + reg = addr)
+// ---------------------------------------------------------
+void Write(unsigned char module, unsigned char reg, int data)
+{
+	long long t0 = CommClock();
+	SimuWrite(module, reg, data);
+	unsigned char databyte[2] = { (unsigned char)((data >> 8) & 0xFF), (unsigned char)(data & 0xFF) };
+	int padding;
+	SimuBusTime(false, 2, &padding);
+	CommStatsRecord(COMM_WRITE, t0, 2, 8, padding, 0, 0);
+	CommRecord(COMM_WRITE, (module << 24) + reg, 2, databyte, t0, 0);
+}
+//-----------------------------------------------------
+// Multiple write of data in word format to the same register
+//-----------------------------------------------------
+int Write_Addr(int addr, int length_inByte, unsigned char data[])
+{
+	long long t0 = CommClock();
+	unsigned char module = (unsigned char)((addr & 0xFF000000) >> 24);
+	unsigned char reg = (unsigned char)(addr & 0x000000FF);
+	for (int i = 0; i < length_inByte / 2; i++) SimuWrite(module, reg, (data[i * 2] << 8) + data[(i * 2) + 1]);
+	int padding;
+	SimuBusTime(false, length_inByte, &padding);
+	CommStatsRecord(COMM_WRITEADDR, t0, length_inByte, 8, padding, 0, 0);
+	CommRecord(COMM_WRITEADDR, addr, length_inByte, data, t0, 0);
+	return(0);
+}
+//---------------------------------------------
+// Multiple write of 8-bit data to the same register
+//---------------------------------------------
+int Write_AddrBytes(int addr, int length, const unsigned char bytes[])
+{
+	if (length < 1) return(0);
+	long long t0 = CommClock();
+	unsigned char module = (unsigned char)((addr & 0xFF000000) >> 24);
+	unsigned char reg = (unsigned char)(addr & 0x000000FF);
+	for (int i = 0; i < length; i++) SimuWrite(module, reg, bytes[i]);
+	int padding;
+	SimuBusTime(false, length * 2, &padding);
+	CommStatsRecord(COMM_WRITEADDR, t0, length * 2, 8, padding, 0, 0);
+	// the log holds the data as sent on the bus
+	std::vector<unsigned char> recordB((size_t)length * 2, 0);
+	for (int i = 0; i < length; i++) recordB[(i * 2) + 1] = bytes[i];
+	CommRecord(COMM_WRITEADDR, addr, length * 2, &recordB[0], t0, 0);
+	return(0);
+}
+//---------------------------------------------
+// Multiple read of data in word format from the same register
+//---------------------------------------------
+int Read_Addr(int addr, int length_inByte, unsigned char data[])
+{
+	long long t0 = CommClock();
+	unsigned char module = (unsigned char)((addr & 0xFF000000) >> 24);
+	unsigned char reg = (unsigned char)(addr & 0x000000FF);
+	for (int i = 0; i < length_inByte / 2; i++)
+	{
+		int value = SimuRead(module, reg);
+		data[i * 2] = (unsigned char)(value >> 8);
+		data[(i * 2) + 1] = (unsigned char)(value & 0xFF);
+	}
+	int padding;
+	SimuBusTime(true, length_inByte, &padding);
+	CommStatsRecord(COMM_READADDR, t0, length_inByte, 8, padding, 0, 0);
+	CommRecord(COMM_READADDR, addr, length_inByte, data, t0, 0);
+	return(0);
+}
+//---------------------------------------------
+// Several write commands in one transfer
+//---------------------------------------------
+int Write_Frames(unsigned char frames[], int length_inByte)
+{
+	long long t0 = CommClock();
+	// a serial bus sends one transfer per command, recorded as such
+	bool perCommand = timingOn && (timing.packetBytes == 0);
+	int pos = 0;
+	while (pos + 8 <= length_inByte)
+	{
+		long long tf = CommClock();
+		int start = pos;
+		unsigned char module = frames[pos + 1] & 0x7F;
+		unsigned char reg = frames[pos + 4];
+		int len = (frames[pos + 5] << 16) + (frames[pos + 6] << 8) + frames[pos + 7];
+		pos += 8;
+		for (int i = 0; (i < len) && (pos + 2 <= length_inByte); i++, pos += 2)
+			SimuWrite(module, reg, (frames[pos] << 8) + frames[pos + 1]);
+		if (perCommand) CommStatsRecord(COMM_WRITEFRAMES, tf, pos - start - 8, 8, 0, 0, 0);
+	}
+	int header, padding;
+	SimuFramesTime(frames, length_inByte, &header, &padding);
+	if (!perCommand) CommStatsRecord(COMM_WRITEFRAMES, t0, length_inByte - header, header, padding, 0, 0);
+	CommRecord(COMM_WRITEFRAMES, 0, length_inByte, frames, t0, 0);
+	return(0);
+}
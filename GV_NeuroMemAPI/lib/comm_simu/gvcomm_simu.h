@@ -0,0 +1,74 @@
+// gvcomm_simu.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Settings of the NeuroMem emulator implemented in gvcomm_simu.cpp
+//
+// The emulator is a comm_xyz.cpp layer like the ones of the hardware
+// platforms: link gvcomm_simu.cpp instead of gvcomm_neuroshield.cpp or
+// comm_brilliant.cpp to run the NeuroMem API without a device.
+//
+#ifndef _gvcomm_simu_h_
+#define _gvcomm_simu_h_
+
+#define SIMU_DEFNEURONS		1024
+#define SIMU_MAXNEURONS		(1 << 20)
+
+// capacity of the emulated network, applied at the next Connect
+void SetSimuNeurons(int neurons);
+int GetSimuNeurons();
+
+//
+// Knowledge mapped from a file
+//
+// MapSimuKnowledge loads a knowledge file into the connected emulator.
+// A KN_COMPACT file saved without compression, with neurons of
+// maxveclength bytes, is mapped with mmap instead of being read: its
+// model and register sections become the neuron store, pages are read
+// from the file on first access, and the processes mapping the same file
+// share one copy of it in memory. The mapping is private, learning and
+// forgetting modify the emulator and never the file.
+// The other files, and all files on Windows, are read into the network.
+// verify checks the Adler-32 of the mapped sections, which reads the
+// whole file; a copied file is always checked.
+// return 0 if successful, or a KN_ERROR_ of NeuroMemKnowledge.h
+//
+int MapSimuKnowledge(const char* filename, int verify);
+// 1 if the neuron store is a file mapping, until the next Connect
+int IsSimuKnowledgeMapped();
+
+//
+// Bus timing model
+//
+// When enabled, every transaction adds the time the modelled platform
+// would spend on the bus to a simulated device clock, and the NeuroMem API
+// takes the code path of that platform (packet transfers with Read_Addr
+// and Write_Addr instead of single register accesses).
+// Bytes are clocked at clockHz; with packetBytes > 0, each direction of a
+// transaction is rounded up to whole packets of that size (USB bulk).
+// The per-transaction latency is best calibrated on hardware with the
+// p50 reported by GetCommStats.
+//
+#define SIMU_TIMING_OFF			0
+#define SIMU_TIMING_NEUROSHIELD	1 // SPI 2MHz behind the Cypress USB-serial bridge
+#define SIMU_TIMING_BRAINCARD	2 // SPI 4MHz driven by the Arduino
+#define SIMU_TIMING_BRILLIANT	3 // USB 2.0 bulk, 512-byte packets
+
+typedef struct
+{
+	int platform;			// value of the platform variable of the modelled comm_xyz.cpp
+	long long clockHz;		// bit rate of the bus
+	int packetBytes;		// bulk packet size, 0 if bytes are clocked individually
+	int fullDuplex;			// 1 if read data is clocked during the command (SPI)
+	long long transactionNs;// fixed cost of a transaction (USB round trip, chip select)
+	long long recognitionNs;// time for the neurons to settle after LCOMP or a CAT write
+} SimuTiming;
+
+void GetSimuTimingPreset(int preset, SimuTiming* timing);
+// NULL disables the timing model
+void SetSimuTiming(const SimuTiming* timing);
+// simulated time spent by the device since the last reset
+unsigned long long GetSimuDeviceNs();
+void ResetSimuDeviceNs();
+
+#endif
@@ -0,0 +1,127 @@
+// GV_features.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Feature extraction declared in GV_features.h
+//
+#include "stdlib.h"	 //for malloc
+#include "GV_features.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FEAT_SSE2
+#include <emmintrin.h>
+#endif
+
+// --------------------------------------------------------------
+// Integral image, one pass with a running sum of the row
+// --------------------------------------------------------------
+int BuildIntegralImage(IntegralImage* ii, const unsigned char* grey, int width, int height, int stride)
+{
+	if ((width < 1) || (height < 1)) return(1);
+	if ((ii->sum == NULL) || (ii->width != width) || (ii->height != height))
+	{
+		free(ii->sum);
+		ii->sum = (unsigned int*)malloc((size_t)(width + 1) * (height + 1) * sizeof(unsigned int));
+		if (ii->sum == NULL) return(1);
+		ii->width = width;
+		ii->height = height;
+	}
+	unsigned int* above = ii->sum;
+	for (int x = 0; x <= width; x++) above[x] = 0;
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* pixels = grey + ((size_t)y * stride);
+		unsigned int* row = above + width + 1;
+		unsigned int rowSum = 0;
+		row[0] = 0;
+		for (int x = 0; x < width; x++)
+		{
+			rowSum += pixels[x];
+			row[x + 1] = above[x + 1] + rowSum;
+		}
+		above = row;
+	}
+	return(0);
+}
+
+void FreeIntegralImage(IntegralImage* ii)
+{
+	free(ii->sum);
+	ii->sum = NULL;
+	ii->width = 0;
+	ii->height = 0;
+}
+
+// --------------------------------------------------------------
+// Grey subsample of a ROI
+// --------------------------------------------------------------
+int GetGreySubsample(const IntegralImage* ii, int roiL, int roiT, int roiW, int roiH, int bW, int bH, int normalize, unsigned char vector[])
+{
+	if ((bW < 1) || (bH < 1) || (roiL < 0) || (roiT < 0) || (roiL + roiW > ii->width) || (roiT + roiH > ii->height)) return(0);
+	int hb = roiW / bW, vb = roiH / bH;
+	if ((hb * vb > FEAT_MAXLENGTH) || (hb * vb < 1)) return(0);
+	unsigned int area = bW * bH;
+	int p = 0;
+	for (int y = 0; y < vb; y++)
+	{
+		for (int x = 0; x < hb; x++)
+			vector[p++] = (unsigned char)(BlockSum(ii, roiL + (x * bW), roiT + (y * bH), bW, bH) / area);
+	}
+	if (normalize) NormalizeVector(vector, p);
+	return(p);
+}
+
+// --------------------------------------------------------------
+// Amplitude normalization
+// The division by max - min is a multiplication by the 32-bit
+// scale = ceil(255 * 2^16 / (max - min)) and a shift by 16, exact for
+// the 8-bit differences. SSE2 multiplies 16 components at once by the
+// two halves of the scale: (d * scale) >> 16 = d * scaleH + ((d * scaleL) >> 16)
+// --------------------------------------------------------------
+void NormalizeVector(unsigned char vector[], int length)
+{
+	if (length < 1) return;
+	int i = 0;
+	unsigned char min = 255, max = 0;
+#ifdef FEAT_SSE2
+	__m128i vmin = _mm_set1_epi8((char)0xFF), vmax = _mm_setzero_si128();
+	for (; i + 16 <= length; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(vector + i));
+		vmin = _mm_min_epu8(vmin, v);
+		vmax = _mm_max_epu8(vmax, v);
+	}
+	unsigned char lanes[32];
+	_mm_storeu_si128((__m128i*)lanes, vmin);
+	_mm_storeu_si128((__m128i*)(lanes + 16), vmax);
+	for (int k = 0; k < 16; k++)
+	{
+		if (lanes[k] < min) min = lanes[k];
+		if (lanes[k + 16] > max) max = lanes[k + 16];
+	}
+#endif
+	for (; i < length; i++)
+	{
+		if (vector[i] < min) min = vector[i];
+		if (vector[i] > max) max = vector[i];
+	}
+	if (max <= min) return;
+	unsigned int scale = ((255u << 16) + (max - min) - 1) / (max - min);
+	i = 0;
+#ifdef FEAT_SSE2
+	__m128i zero = _mm_setzero_si128();
+	__m128i offset = _mm_set1_epi16(min);
+	__m128i scaleH = _mm_set1_epi16((short)(scale >> 16));
+	__m128i scaleL = _mm_set1_epi16((short)(scale & 0xFFFF));
+	for (; i + 16 <= length; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(vector + i));
+		__m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), offset);
+		__m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(v, zero), offset);
+		lo = _mm_add_epi16(_mm_mullo_epi16(lo, scaleH), _mm_mulhi_epu16(lo, scaleL));
+		hi = _mm_add_epi16(_mm_mullo_epi16(hi, scaleH), _mm_mulhi_epu16(hi, scaleL));
+		_mm_storeu_si128((__m128i*)(vector + i), _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for (; i < length; i++) vector[i] = (unsigned char)(((vector[i] - min) * scale) >> 16);
+}
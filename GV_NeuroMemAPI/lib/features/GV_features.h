@@ -0,0 +1,52 @@
+// GV_features.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Feature extraction from images into the vectors of 8-bit components
+// broadcast to the neurons (see the unsigned char overloads of NeuroMem.h)
+//
+// The grey subsample of a region of interest (ROI) is the mean of each
+// block of bW x bH pixels, row by row, as GetGreySubsample of the Python
+// examples and getFeatureVectors of the Arduino examples. The blocks are
+// summed with an integral image built once per frame, so each block costs
+// 4 reads whatever its size and the ROIs of a frame share the same image.
+//
+#ifndef _GV_features_h_
+#define _GV_features_h_
+
+#include "stddef.h" // size_t
+
+#define FEAT_MAXLENGTH	256		// memory of a neuron
+
+typedef struct
+{
+	int width;
+	int height;
+	// (width + 1) * (height + 1) sums of the pixels above and left of each
+	// position, modulo 2^32 which keeps the sum of any block of less than
+	// 2^24 pixels exact
+	unsigned int* sum;
+} IntegralImage;
+
+// build the integral image of a grey image of stride bytes per row
+// ii->sum is reused when the size does not change, return 0 if successful
+int BuildIntegralImage(IntegralImage* ii, const unsigned char* grey, int width, int height, int stride);
+void FreeIntegralImage(IntegralImage* ii);
+
+// sum of the pixels of a block
+inline unsigned int BlockSum(const IntegralImage* ii, int left, int top, int width, int height)
+{
+	const unsigned int* row0 = ii->sum + ((size_t)top * (ii->width + 1)) + left;
+	const unsigned int* row1 = row0 + ((size_t)height * (ii->width + 1));
+	return(row1[width] - row1[0] - row0[width] + row0[0]);
+}
+
+// vector of the roiW/bW x roiH/bH block means of a ROI, stretched to 0-255
+// if normalize is set; return the length of the vector, 0 if the ROI is not
+// in the image or the vector is longer than FEAT_MAXLENGTH
+int GetGreySubsample(const IntegralImage* ii, int roiL, int roiT, int roiW, int roiH, int bW, int bH, int normalize, unsigned char vector[]);
+
+// stretch the components to 0-255: (v - min) * 255 / (max - min)
+void NormalizeVector(unsigned char vector[], int length);
+
+#endif
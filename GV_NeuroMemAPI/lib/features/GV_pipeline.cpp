@@ -0,0 +1,343 @@
+// GV_pipeline.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Pipeline declared in GV_pipeline.h
+//
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "GV_pipeline.h"
+
+#define PIPE_SPINS		64		// yields before blocking while a queue is empty or full
+
+// nanoseconds of a monotonic clock
+static long long Now()
+{
+	return(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// --------------------------------------------------------------
+// Bounded queue for several producers and consumers
+// Each cell has a sequence number telling whether it is free
+// for the position of a producer or filled for the position of
+// a consumer, the positions are taken by compare and swap
+// --------------------------------------------------------------
+struct PipeCell
+{
+	std::atomic<size_t> sequence;
+	void* item;
+	long long submitNs;
+};
+
+struct PipeQueue
+{
+	PipeCell* cells;
+	size_t mask;
+	char padHead[64];						// producers and consumers on separate cache lines
+	std::atomic<size_t> head;				// next position to fill
+	char padTail[64];
+	std::atomic<size_t> tail;				// next position to take
+};
+
+static void QueueOpen(PipeQueue* q, int capacity)
+{
+	size_t size = 1;
+	while (size < (size_t)capacity) size <<= 1;
+	q->cells = new PipeCell[size];
+	for (size_t i = 0; i < size; i++) q->cells[i].sequence.store(i, std::memory_order_relaxed);
+	q->mask = size - 1;
+	q->head.store(0, std::memory_order_relaxed);
+	q->tail.store(0, std::memory_order_relaxed);
+}
+
+static bool QueuePush(PipeQueue* q, void* item, long long submitNs)
+{
+	size_t position = q->head.load(std::memory_order_relaxed);
+	PipeCell* cell;
+	for (;;)
+	{
+		cell = &q->cells[position & q->mask];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		long long diff = (long long)sequence - (long long)position;
+		if (diff == 0)
+		{
+			if (q->head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+		}
+		else if (diff < 0) return(false);
+		else position = q->head.load(std::memory_order_relaxed);
+	}
+	cell->item = item;
+	cell->submitNs = submitNs;
+	cell->sequence.store(position + 1, std::memory_order_release);
+	return(true);
+}
+
+static bool QueuePop(PipeQueue* q, void** item, long long* submitNs)
+{
+	size_t position = q->tail.load(std::memory_order_relaxed);
+	PipeCell* cell;
+	for (;;)
+	{
+		cell = &q->cells[position & q->mask];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		long long diff = (long long)sequence - (long long)(position + 1);
+		if (diff == 0)
+		{
+			if (q->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+		}
+		else if (diff < 0) return(false);
+		else position = q->tail.load(std::memory_order_relaxed);
+	}
+	*item = cell->item;
+	*submitNs = cell->submitNs;
+	cell->sequence.store(position + q->mask + 1, std::memory_order_release);
+	return(true);
+}
+
+static int QueueCount(PipeQueue* q)
+{
+	size_t head = q->head.load(std::memory_order_relaxed);
+	size_t tail = q->tail.load(std::memory_order_relaxed);
+	return(head > tail ? (int)(head - tail) : 0);
+}
+
+// --------------------------------------------------------------
+// Stages
+// --------------------------------------------------------------
+struct PipeStage
+{
+	PipelineStage settings;
+	PipeQueue queue;
+	std::thread workers[PIPE_MAXWORKERS];
+	std::atomic<unsigned long long> items;
+	std::atomic<unsigned long long> dropped;
+	std::atomic<unsigned long long> busyNs;
+	std::atomic<unsigned long long> blockedNs;
+};
+
+struct Pipeline
+{
+	int count;
+	PipeStage stages[PIPE_MAXSTAGES];
+	long long startNs;
+	std::atomic<bool> stop;
+	std::atomic<unsigned long long> submitted;
+	std::atomic<unsigned long long> completed;
+	std::atomic<unsigned long long> latencyNs;
+	std::atomic<unsigned long long> maxLatencyNs;
+	std::atomic<unsigned long long> blockedNs;
+	// threads blocked until a queue or the completions change
+	std::mutex lock;
+	std::condition_variable wake;
+	std::atomic<unsigned int> events;
+	std::atomic<int> sleepers;
+};
+
+// --------------------------------------------------------------
+// Waits: a thread yields PIPE_SPINS times, then counts itself in
+// the sleepers, takes the count of events and blocks until the
+// next event unless ready() already holds. An event signaled
+// before the count was taken is seen by ready(), one signaled
+// after it finds the sleeper and notifies it under the lock.
+// --------------------------------------------------------------
+static void Signal(Pipeline* pipeline)
+{
+	pipeline->events.fetch_add(1);
+	if (pipeline->sleepers.load() == 0) return;
+	{
+		std::lock_guard<std::mutex> lock(pipeline->lock);
+	}
+	pipeline->wake.notify_all();
+}
+
+template <typename Ready>
+static void Wait(Pipeline* pipeline, int* spins, Ready ready)
+{
+	if (++*spins < PIPE_SPINS)
+	{
+		std::this_thread::yield();
+		return;
+	}
+	pipeline->sleepers.fetch_add(1);
+	unsigned int events = pipeline->events.load();
+	if (!ready())
+	{
+		std::unique_lock<std::mutex> lock(pipeline->lock);
+		pipeline->wake.wait(lock, [&]() { return pipeline->events.load() != events; });
+	}
+	pipeline->sleepers.fetch_sub(1);
+}
+
+// push an item, waiting for room, return the time waited
+static long long Forward(Pipeline* pipeline, PipeQueue* q, void* item, long long submitNs)
+{
+	long long t0 = 0;
+	int spins = 0;
+	while (!QueuePush(q, item, submitNs))
+	{
+		if (t0 == 0) t0 = Now();
+		Wait(pipeline, &spins, [q]() { return(QueueCount(q) <= (int)q->mask); });
+	}
+	Signal(pipeline);
+	return(t0 == 0 ? 0 : Now() - t0);
+}
+
+static void Complete(Pipeline* pipeline, long long submitNs)
+{
+	unsigned long long latency = Now() - submitNs;
+	pipeline->latencyNs.fetch_add(latency, std::memory_order_relaxed);
+	unsigned long long max = pipeline->maxLatencyNs.load(std::memory_order_relaxed);
+	while ((latency > max) && !pipeline->maxLatencyNs.compare_exchange_weak(max, latency, std::memory_order_relaxed));
+	pipeline->completed.fetch_add(1, std::memory_order_release);
+	Signal(pipeline);
+}
+
+static void Worker(Pipeline* pipeline, int s)
+{
+	PipeStage* stage = &pipeline->stages[s];
+	PipeQueue* next = s + 1 < pipeline->count ? &pipeline->stages[s + 1].queue : NULL;
+	int spins = 0;
+	for (;;)
+	{
+		void* item;
+		long long submitNs;
+		if (!QueuePop(&stage->queue, &item, &submitNs))
+		{
+			if (pipeline->stop.load(std::memory_order_acquire)) return;
+			Wait(pipeline, &spins, [pipeline, stage]() { return(pipeline->stop.load() || (QueueCount(&stage->queue) > 0)); });
+			continue;
+		}
+		spins = 0;
+		Signal(pipeline);	// room in the queue
+		long long t0 = Now();
+		int result = stage->settings.process(stage->settings.context, item);
+		stage->busyNs.fetch_add(Now() - t0, std::memory_order_relaxed);
+		stage->items.fetch_add(1, std::memory_order_relaxed);
+		if (result != 0)
+		{
+			stage->dropped.fetch_add(1, std::memory_order_relaxed);
+			Complete(pipeline, submitNs);
+		}
+		else if (next != NULL) stage->blockedNs.fetch_add(Forward(pipeline, next, item, submitNs), std::memory_order_relaxed);
+		else Complete(pipeline, submitNs);
+	}
+}
+
+Pipeline* PipelineOpen(const PipelineStage stages[], int count)
+{
+	if ((count < 1) || (count > PIPE_MAXSTAGES)) return(NULL);
+	for (int s = 0; s < count; s++)
+	{
+		if ((stages[s].process == NULL) || (stages[s].workers < 1) || (stages[s].workers > PIPE_MAXWORKERS) || (stages[s].capacity < 1)) return(NULL);
+	}
+	Pipeline* pipeline = new Pipeline();
+	pipeline->count = count;
+	pipeline->stop.store(false);
+	pipeline->submitted.store(0);
+	pipeline->completed.store(0);
+	pipeline->latencyNs.store(0);
+	pipeline->maxLatencyNs.store(0);
+	pipeline->blockedNs.store(0);
+	pipeline->events.store(0);
+	pipeline->sleepers.store(0);
+	pipeline->startNs = Now();
+	for (int s = 0; s < count; s++)
+	{
+		PipeStage* stage = &pipeline->stages[s];
+		stage->settings = stages[s];
+		stage->items.store(0);
+		stage->dropped.store(0);
+		stage->busyNs.store(0);
+		stage->blockedNs.store(0);
+		QueueOpen(&stage->queue, stages[s].capacity);
+	}
+	for (int s = 0; s < count; s++)
+	{
+		for (int w = 0; w < stages[s].workers; w++) pipeline->stages[s].workers[w] = std::thread(Worker, pipeline, s);
+	}
+	return(pipeline);
+}
+
+void PipelineClose(Pipeline* pipeline)
+{
+	PipelineDrain(pipeline);
+	pipeline->stop.store(true, std::memory_order_release);
+	Signal(pipeline);
+	for (int s = 0; s < pipeline->count; s++)
+	{
+		PipeStage* stage = &pipeline->stages[s];
+		for (int w = 0; w < stage->settings.workers; w++) stage->workers[w].join();
+		delete[] stage->queue.cells;
+	}
+	delete pipeline;
+}
+
+void PipelineSubmit(Pipeline* pipeline, void* item)
+{
+	pipeline->submitted.fetch_add(1, std::memory_order_relaxed);
+	pipeline->blockedNs.fetch_add(Forward(pipeline, &pipeline->stages[0].queue, item, Now()), std::memory_order_relaxed);
+}
+
+int PipelineTrySubmit(Pipeline* pipeline, void* item)
+{
+	if (!QueuePush(&pipeline->stages[0].queue, item, Now())) return(1);
+	pipeline->submitted.fetch_add(1, std::memory_order_relaxed);
+	Signal(pipeline);
+	return(0);
+}
+
+void PipelineDrain(Pipeline* pipeline)
+{
+	int spins = 0;
+	auto done = [pipeline]() { return(pipeline->completed.load(std::memory_order_acquire) >= pipeline->submitted.load(std::memory_order_relaxed)); };
+	while (!done()) Wait(pipeline, &spins, done);
+}
+
+// --------------------------------------------------------------
+// Statistics
+// --------------------------------------------------------------
+void PipelineGetStats(Pipeline* pipeline, PipelineStats* stats)
+{
+	stats->stages = pipeline->count;
+	stats->elapsedNs = Now() - pipeline->startNs;
+	for (int s = 0; s < pipeline->count; s++)
+	{
+		PipeStage* stage = &pipeline->stages[s];
+		PipelineStageStats* st = &stats->stage[s];
+		st->name = stage->settings.name;
+		st->workers = stage->settings.workers;
+		st->items = stage->items.load(std::memory_order_relaxed);
+		st->dropped = stage->dropped.load(std::memory_order_relaxed);
+		st->busyNs = stage->busyNs.load(std::memory_order_relaxed);
+		st->blockedNs = stage->blockedNs.load(std::memory_order_relaxed);
+		st->queued = QueueCount(&stage->queue);
+		st->utilisation = stats->elapsedNs ? (double)st->busyNs / ((double)st->workers * stats->elapsedNs) : 0.0;
+	}
+	stats->submitted = pipeline->submitted.load(std::memory_order_relaxed);
+	stats->completed = pipeline->completed.load(std::memory_order_acquire);
+	stats->latencyNs = pipeline->latencyNs.load(std::memory_order_relaxed);
+	stats->maxLatencyNs = pipeline->maxLatencyNs.load(std::memory_order_relaxed);
+	stats->blockedNs = pipeline->blockedNs.load(std::memory_order_relaxed);
+	stats->throughput = stats->elapsedNs ? (stats->completed * 1e9) / stats->elapsedNs : 0.0;
+}
+
+void PipelineReport(Pipeline* pipeline, FILE* out)
+{
+	PipelineStats stats;
+	PipelineGetStats(pipeline, &stats);
+	fprintf(out, "\n%-16s %8s %10s %10s %12s %12s %12s %8s",
+		"Stage", "Workers", "Items", "Dropped", "Busy ms", "Blocked ms", "Utilisation", "Queued");
+	for (int s = 0; s < stats.stages; s++)
+	{
+		PipelineStageStats* st = &stats.stage[s];
+		fprintf(out, "\n%-16s %8d %10llu %10llu %12.3f %12.3f %11.1f%% %8d",
+			st->name ? st->name : "", st->workers, st->items, st->dropped, st->busyNs / 1e6, st->blockedNs / 1e6, 100.0 * st->utilisation, st->queued);
+	}
+	fprintf(out, "\nSubmitted %llu, completed %llu in %.3f ms, %.1f items/s, submit blocked %.3f ms",
+		stats.submitted, stats.completed, stats.elapsedNs / 1e6, stats.throughput, stats.blockedNs / 1e6);
+	fprintf(out, "\nLatency mean %.3f ms, max %.3f ms\n",
+		stats.completed ? stats.latencyNs / 1e6 / stats.completed : 0.0, stats.maxLatencyNs / 1e6);
+}
@@ -0,0 +1,83 @@
+// GV_pipeline.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Pipeline of stages overlapping the capture, the feature extraction and
+// the recognition of a stream of frames or sensor windows
+//
+// The items submitted to the pipeline (a frame buffer, a window of
+// samples...) go through the stages in order. Each stage runs its function
+// on its own worker threads, and takes its items from a bounded lock-free
+// queue filled by the previous stage. When a queue is full, the stage
+// feeding it waits, up to PipelineSubmit, so the items in flight are
+// bounded and the throughput is that of the slowest stage. A thread
+// waiting for an item, for room or in PipelineDrain yields a few times,
+// then blocks on a condition variable until the pipeline changes.
+//
+// The neurons are accessed by one thread at a time: a stage calling the
+// NeuroMem API (Broadcast, BestMatch, Learn...) must have a single worker.
+// With several workers a stage may reorder the items.
+//
+#ifndef _GV_pipeline_h_
+#define _GV_pipeline_h_
+
+#include "stdio.h" // FILE
+
+#define PIPE_MAXSTAGES		8
+#define PIPE_MAXWORKERS		16
+
+// return 0 to pass the item to the next stage, other values drop it
+typedef int (*PipelineFunction)(void* context, void* item);
+
+typedef struct
+{
+	const char* name;
+	PipelineFunction process;
+	void* context;
+	int workers;				// threads running the stage
+	int capacity;				// items in the queue before the stage
+} PipelineStage;
+
+typedef struct
+{
+	const char* name;
+	int workers;
+	unsigned long long items;		// processed
+	unsigned long long dropped;
+	unsigned long long busyNs;		// inside the function
+	unsigned long long blockedNs;	// waiting for room in the next queue
+	int queued;						// items waiting before the stage
+	double utilisation;				// busyNs / (workers * elapsedNs)
+} PipelineStageStats;
+
+typedef struct
+{
+	int stages;
+	PipelineStageStats stage[PIPE_MAXSTAGES];
+	unsigned long long submitted;
+	unsigned long long completed;	// through the last stage or dropped
+	unsigned long long elapsedNs;	// since PipelineOpen
+	unsigned long long latencyNs;	// total from the submission to the completion
+	unsigned long long maxLatencyNs;
+	unsigned long long blockedNs;	// waiting in PipelineSubmit
+	double throughput;				// items completed per second
+} PipelineStats;
+
+struct Pipeline;
+
+// start the workers of count stages, return NULL if a stage is invalid
+Pipeline* PipelineOpen(const PipelineStage stages[], int count);
+// complete the items in flight, stop the workers and free the pipeline
+void PipelineClose(Pipeline* pipeline);
+// queue an item for the first stage, waiting for room
+void PipelineSubmit(Pipeline* pipeline, void* item);
+// return 1 if the queue of the first stage is full
+int PipelineTrySubmit(Pipeline* pipeline, void* item);
+// wait until the items submitted are completed
+void PipelineDrain(Pipeline* pipeline);
+
+void PipelineGetStats(Pipeline* pipeline, PipelineStats* stats);
+// per-stage table of items, utilisation and waits, and the latency
+void PipelineReport(Pipeline* pipeline, FILE* out);
+
+#endif
@@ -0,0 +1,177 @@
+// GV_pyramid.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Multi-scale scan declared in GV_pyramid.h
+//
+#include "stdlib.h"	 //for malloc
+#include "../neuromem/NeuroMem.h"
+#include "GV_pyramid.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FEAT_SSE2
+#include <emmintrin.h>
+#endif
+
+// --------------------------------------------------------------
+// 2x2 box filter, the rounded mean (a + b + c + d + 2) / 4
+// SSE2 adds the even and odd bytes of 16-bit lanes, 16 pixels
+// out of 32 of each of the two rows at once
+// --------------------------------------------------------------
+void ReduceImage(const unsigned char* grey, int width, int height, int stride, unsigned char* reduced)
+{
+	int rw = width / 2, rh = height / 2;
+	for (int y = 0; y < rh; y++)
+	{
+		const unsigned char* row0 = grey + ((size_t)(2 * y) * stride);
+		const unsigned char* row1 = row0 + stride;
+		unsigned char* out = reduced + ((size_t)y * rw);
+		int x = 0;
+#ifdef FEAT_SSE2
+		__m128i even = _mm_set1_epi16(0x00FF);
+		__m128i two = _mm_set1_epi16(2);
+		for (; x + 16 <= rw; x += 16)
+		{
+			__m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + (2 * x)));
+			__m128i a1 = _mm_loadu_si128((const __m128i*)(row0 + (2 * x) + 16));
+			__m128i b0 = _mm_loadu_si128((const __m128i*)(row1 + (2 * x)));
+			__m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + (2 * x) + 16));
+			__m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a0, even), _mm_srli_epi16(a0, 8)),
+				_mm_add_epi16(_mm_and_si128(b0, even), _mm_srli_epi16(b0, 8)));
+			__m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a1, even), _mm_srli_epi16(a1, 8)),
+				_mm_add_epi16(_mm_and_si128(b1, even), _mm_srli_epi16(b1, 8)));
+			lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+			hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+			_mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(lo, hi));
+		}
+#endif
+		for (; x < rw; x++)
+			out[x] = (unsigned char)((row0[2 * x] + row0[(2 * x) + 1] + row1[2 * x] + row1[(2 * x) + 1] + 2) >> 2);
+	}
+}
+
+// --------------------------------------------------------------
+// Pyramid, the buffers of a level are reused while its size
+// does not change
+// --------------------------------------------------------------
+int BuildPyramid(ImagePyramid* pyramid, const unsigned char* grey, int width, int height, int stride, int levels, int minW, int minH)
+{
+	if (levels > PYR_MAXLEVELS) levels = PYR_MAXLEVELS;
+	pyramid->levels = 0;
+	for (int n = 0; n < levels; n++)
+	{
+		if ((width < minW) || (height < minH) || (width < 1) || (height < 1)) break;
+		if (n > 0)
+		{
+			if ((pyramid->grey[n] == NULL) || (pyramid->width[n] != width) || (pyramid->height[n] != height))
+			{
+				free(pyramid->grey[n]);
+				pyramid->grey[n] = (unsigned char*)malloc((size_t)width * height);
+				if (pyramid->grey[n] == NULL) break;
+			}
+			ReduceImage(grey, width * 2, height * 2, stride, pyramid->grey[n]);
+			grey = pyramid->grey[n];
+			stride = width;
+		}
+		if (BuildIntegralImage(&pyramid->ii[n], grey, width, height, stride) != 0) break;
+		pyramid->width[n] = width;
+		pyramid->height[n] = height;
+		pyramid->levels = n + 1;
+		width /= 2;
+		height /= 2;
+	}
+	return(pyramid->levels);
+}
+
+void FreePyramid(ImagePyramid* pyramid)
+{
+	for (int n = 0; n < PYR_MAXLEVELS; n++)
+	{
+		free(pyramid->grey[n]);
+		pyramid->grey[n] = NULL;
+		FreeIntegralImage(&pyramid->ii[n]);
+	}
+	pyramid->levels = 0;
+}
+
+// --------------------------------------------------------------
+// Non-maximum suppression
+// --------------------------------------------------------------
+static int CompareHits(const void* a, const void* b)
+{
+	const PyramidHit* h1 = (const PyramidHit*)a;
+	const PyramidHit* h2 = (const PyramidHit*)b;
+	if (h1->distance != h2->distance) return(h1->distance - h2->distance);
+	if (h1->level != h2->level) return(h1->level - h2->level);
+	if (h1->y != h2->y) return(h1->y - h2->y);
+	return(h1->x - h2->x);
+}
+
+static int Overlaps(const PyramidHit* h1, const PyramidHit* h2, int overlap)
+{
+	int l1 = h1->x - (h1->width / 2), t1 = h1->y - (h1->height / 2);
+	int l2 = h2->x - (h2->width / 2), t2 = h2->y - (h2->height / 2);
+	int w = (l1 + h1->width < l2 + h2->width ? l1 + h1->width : l2 + h2->width) - (l1 > l2 ? l1 : l2);
+	int h = (t1 + h1->height < t2 + h2->height ? t1 + h1->height : t2 + h2->height) - (t1 > t2 ? t1 : t2);
+	if ((w <= 0) || (h <= 0)) return(0);
+	long long common = (long long)w * h;
+	long long both = ((long long)h1->width * h1->height) + ((long long)h2->width * h2->height) - common;
+	return(common * 100 >= both * overlap);
+}
+
+static int SuppressHits(PyramidHit hits[], int count, int overlap)
+{
+	qsort(hits, count, sizeof(PyramidHit), CompareHits);
+	if (overlap > 100) return(count);
+	int kept = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int k = 0;
+		while ((k < kept) && !Overlaps(&hits[k], &hits[i], overlap)) k++;
+		if (k == kept) hits[kept++] = hits[i];
+	}
+	return(kept);
+}
+
+// --------------------------------------------------------------
+// Scan of the levels
+// --------------------------------------------------------------
+int ScanPyramid(const ImagePyramid* pyramid, int rosL, int rosT, int rosW, int rosH, const ScanSettings* settings, const int contexts[], int overlap, PyramidHit hits[], int maxHits)
+{
+	if ((pyramid->levels < 1) || (maxHits < 1)) return(0);
+	// clip the ROS to the frame, so that it can be reduced with the levels
+	if (rosL < 0) { rosW += rosL; rosL = 0; }
+	if (rosT < 0) { rosH += rosT; rosT = 0; }
+	if (rosL + rosW > pyramid->width[0]) rosW = pyramid->width[0] - rosL;
+	if (rosT + rosH > pyramid->height[0]) rosH = pyramid->height[0] - rosT;
+	if ((rosW < 1) || (rosH < 1)) return(0);
+	ScanHit* found = (ScanHit*)malloc(maxHits * sizeof(ScanHit));
+	if (found == NULL) return(0);
+	int context = 0, minif = 0, maxif = 0;
+	if (contexts != NULL) getContext(&context, &minif, &maxif);
+	int count = 0;
+	for (int n = 0; (n < pyramid->levels) && (count < maxHits); n++)
+	{
+		// windows of the level inside the ROS of the frame
+		int left = (rosL + (1 << n) - 1) >> n, top = (rosT + (1 << n) - 1) >> n;
+		int width = ((rosL + rosW) >> n) - left, height = ((rosT + rosH) >> n) - top;
+		if ((width < settings->roiW) || (height < settings->roiH)) break;
+		if (contexts != NULL) setContext(contexts[n], minif, maxif);
+		int levelHits = SurveyROS(&pyramid->ii[n], left, top, width, height, settings, found, maxHits - count);
+		if (levelHits > maxHits - count) levelHits = maxHits - count;
+		for (int i = 0; i < levelHits; i++)
+		{
+			PyramidHit* hit = &hits[count++];
+			hit->width = settings->roiW << n;
+			hit->height = settings->roiH << n;
+			hit->x = ((found[i].x - (settings->roiW / 2)) << n) + (hit->width / 2);
+			hit->y = ((found[i].y - (settings->roiH / 2)) << n) + (hit->height / 2);
+			hit->level = n;
+			hit->category = found[i].category;
+			hit->distance = found[i].distance;
+		}
+	}
+	if (contexts != NULL) setContext(context, minif, maxif);
+	free(found);
+	return(SuppressHits(hits, count, overlap));
+}
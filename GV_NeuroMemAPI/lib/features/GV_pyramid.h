@@ -0,0 +1,55 @@
+// GV_pyramid.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Multi-scale scan of a frame with the window of GV_scan.h
+//
+// Each level of the pyramid is the previous one reduced by 2 with a 2x2
+// box filter, so the same window covers an object twice as large at the
+// next level. The levels and their integral images are kept from one frame
+// to the next, and all the levels together are 4/3 of the pixels of the
+// frame, so a scan of every level costs at most 4/3 of the scan of the frame.
+//
+#ifndef _GV_pyramid_h_
+#define _GV_pyramid_h_
+
+#include "GV_scan.h"
+
+#define PYR_MAXLEVELS	8
+
+typedef struct
+{
+	int levels;
+	int width[PYR_MAXLEVELS];
+	int height[PYR_MAXLEVELS];
+	unsigned char* grey[PYR_MAXLEVELS];		// reduced images, NULL for the frame
+	IntegralImage ii[PYR_MAXLEVELS];
+} ImagePyramid;
+
+typedef struct
+{
+	int x, y;				// center of the window in the frame
+	int width, height;		// of the window in the frame
+	int level;
+	int category;
+	int distance;
+} PyramidHit;
+
+// build up to levels levels of a grey image of stride bytes per row, fewer
+// if the image becomes smaller than minW x minH; the pyramid must be zeroed
+// before its first use, return the number of levels
+int BuildPyramid(ImagePyramid* pyramid, const unsigned char* grey, int width, int height, int stride, int levels, int minW, int minH);
+void FreePyramid(ImagePyramid* pyramid);
+
+// reduce an image by 2 with a 2x2 box filter into width/2 x height/2 bytes
+void ReduceImage(const unsigned char* grey, int width, int height, int stride, unsigned char* reduced);
+
+// scan the ROS of the frame at each level of the pyramid, recognizing the
+// windows of level n in the context contexts[n] if contexts is not NULL;
+// the hits are sorted by distance and a hit whose window overlaps the
+// window of a closer one by overlap percent or more of their union is
+// suppressed (more than 100 keeps all the hits); return the number of hits
+// kept among the first maxHits found
+int ScanPyramid(const ImagePyramid* pyramid, int rosL, int rosT, int rosW, int rosH, const ScanSettings* settings, const int contexts[], int overlap, PyramidHit hits[], int maxHits);
+
+#endif
@@ -0,0 +1,180 @@
+// GV_scan.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Sliding window scan declared in GV_scan.h
+//
+#include "stdlib.h"	 //for malloc
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "../neuromem/NeuroMem.h"
+#include "GV_scan.h"
+
+#define SCAN_CHUNK		1024	// windows recognized per BestMatchBatch
+#define SCAN_SLICE		16		// minimum windows extracted per worker
+
+typedef struct
+{
+	const IntegralImage* ii;
+	const ScanSettings* settings;
+	int left, top;		// first window
+	int columns;		// windows per row
+	int length;			// of the vectors
+} ScanGrid;
+
+// --------------------------------------------------------------
+// Workers extracting the chunks of windows, started once per scan
+// Each chunk posted is split in one slice per worker
+// --------------------------------------------------------------
+struct Extraction
+{
+	const ScanGrid* grid;
+	int threads;
+	std::mutex lock;
+	std::condition_variable posted;
+	std::condition_variable done;
+	int chunks;			// posted since the start
+	int pending;		// workers extracting the last chunk
+	bool stop;
+	int first, count;	// windows of the last chunk
+	unsigned char* vectors;
+	std::vector<std::thread> workers;
+};
+
+static void ExtractionWorker(Extraction* e, int slice)
+{
+	const ScanGrid* grid = e->grid;
+	const ScanSettings* s = grid->settings;
+	int chunks = 0;
+	for (;;)
+	{
+		int first, count;
+		unsigned char* vectors;
+		{
+			std::unique_lock<std::mutex> lock(e->lock);
+			e->posted.wait(lock, [&]() { return e->stop || (e->chunks != chunks); });
+			if (e->stop) return;
+			chunks = e->chunks;
+			first = e->first;
+			count = e->count;
+			vectors = e->vectors;
+		}
+		int perThread = (count + e->threads - 1) / e->threads;
+		int end = (slice + 1) * perThread < count ? (slice + 1) * perThread : count;
+		for (int i = slice * perThread; i < end; i++)
+		{
+			int w = first + i;
+			int x = grid->left + ((w % grid->columns) * s->stepX);
+			int y = grid->top + ((w / grid->columns) * s->stepY);
+			GetGreySubsample(grid->ii, x, y, s->roiW, s->roiH, s->bW, s->bH, s->normalize, vectors + ((size_t)i * grid->length));
+		}
+		std::lock_guard<std::mutex> lock(e->lock);
+		if (--e->pending == 0) e->done.notify_one();
+	}
+}
+
+static void ExtractionOpen(Extraction* e, const ScanGrid* grid, int threads)
+{
+	e->grid = grid;
+	e->threads = threads;
+	e->chunks = 0;
+	e->pending = 0;
+	e->stop = false;
+	for (int t = 0; t < threads; t++) e->workers.emplace_back(ExtractionWorker, e, t);
+}
+
+// extract the windows [first, first + count) into vectors
+static void StartExtraction(Extraction* e, int first, int count, unsigned char* vectors)
+{
+	std::lock_guard<std::mutex> lock(e->lock);
+	e->first = first;
+	e->count = count;
+	e->vectors = vectors;
+	e->pending = e->threads;
+	e->chunks++;
+	e->posted.notify_all();
+}
+
+static void WaitExtraction(Extraction* e)
+{
+	std::unique_lock<std::mutex> lock(e->lock);
+	e->done.wait(lock, [&]() { return e->pending == 0; });
+}
+
+static void ExtractionClose(Extraction* e)
+{
+	{
+		std::lock_guard<std::mutex> lock(e->lock);
+		e->stop = true;
+		e->posted.notify_all();
+	}
+	for (size_t t = 0; t < e->workers.size(); t++) e->workers[t].join();
+}
+
+int SurveyROS(const IntegralImage* ii, int rosL, int rosT, int rosW, int rosH, const ScanSettings* settings, ScanHit hits[], int maxHits)
+{
+	const ScanSettings* s = settings;
+	if ((s->bW < 1) || (s->bH < 1) || (s->stepX < 1) || (s->stepY < 1)) return(0);
+	// clip the ROS to the image
+	if (rosL < 0) { rosW += rosL; rosL = 0; }
+	if (rosT < 0) { rosH += rosT; rosT = 0; }
+	if (rosL + rosW > ii->width) rosW = ii->width - rosL;
+	if (rosT + rosH > ii->height) rosH = ii->height - rosT;
+	ScanGrid grid;
+	grid.ii = ii;
+	grid.settings = s;
+	grid.left = rosL;
+	grid.top = rosT;
+	grid.length = (s->roiW / s->bW) * (s->roiH / s->bH);
+	if ((grid.length < 1) || (grid.length > FEAT_MAXLENGTH) || (rosW < s->roiW) || (rosH < s->roiH)) return(0);
+	grid.columns = ((rosW - s->roiW) / s->stepX) + 1;
+	int rows = ((rosH - s->roiH) / s->stepY) + 1;
+	int windows = grid.columns * rows;
+	int threads = s->threads > 0 ? s->threads : (int)std::thread::hardware_concurrency();
+	// slices of at least SCAN_SLICE windows
+	int chunk = windows < SCAN_CHUNK ? windows : SCAN_CHUNK;
+	if (threads > (chunk + SCAN_SLICE - 1) / SCAN_SLICE) threads = (chunk + SCAN_SLICE - 1) / SCAN_SLICE;
+	if (threads < 1) threads = 1;
+
+	unsigned char* vectors[2];
+	vectors[0] = (unsigned char*)malloc((size_t)SCAN_CHUNK * grid.length);
+	vectors[1] = (unsigned char*)malloc((size_t)SCAN_CHUNK * grid.length);
+	int* distance = (int*)malloc(SCAN_CHUNK * sizeof(int));
+	int* category = (int*)malloc(SCAN_CHUNK * sizeof(int));
+	int* nid = (int*)malloc(SCAN_CHUNK * sizeof(int));
+	Extraction extraction;
+	ExtractionOpen(&extraction, &grid, threads);
+	int found = 0;
+	StartExtraction(&extraction, 0, chunk, vectors[0]);
+	for (int first = 0, b = 0; first < windows; first += SCAN_CHUNK, b ^= 1)
+	{
+		WaitExtraction(&extraction);
+		int count = windows - first < SCAN_CHUNK ? windows - first : SCAN_CHUNK;
+		int next = first + count;
+		if (next < windows)
+			StartExtraction(&extraction, next, windows - next < SCAN_CHUNK ? windows - next : SCAN_CHUNK, vectors[b ^ 1]);
+		BestMatchBatch(vectors[b], grid.length, count, distance, category, nid);
+		for (int i = 0; i < count; i++)
+		{
+			if (distance[i] == 0xFFFF) continue;
+			if (found < maxHits)
+			{
+				int w = first + i;
+				hits[found].x = rosL + ((w % grid.columns) * s->stepX) + (s->roiW / 2);
+				hits[found].y = rosT + ((w / grid.columns) * s->stepY) + (s->roiH / 2);
+				hits[found].category = category[i];
+				hits[found].distance = distance[i];
+			}
+			found++;
+		}
+	}
+	ExtractionClose(&extraction);
+	free(vectors[0]);
+	free(vectors[1]);
+	free(distance);
+	free(category);
+	free(nid);
+	return(found);
+}
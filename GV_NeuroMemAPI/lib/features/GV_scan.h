@@ -0,0 +1,39 @@
+// GV_scan.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Scan of a region of search (ROS) with a sliding region of interest,
+// as surveyROS of the Python examples
+//
+// All the windows read the integral image of the frame (see GV_features.h).
+// Their grey subsamples are extracted by worker threads, started once per
+// scan, one chunk of windows ahead, while the previous chunk is recognized
+// by the neurons with BestMatchBatch.
+//
+#ifndef _GV_scan_h_
+#define _GV_scan_h_
+
+#include "GV_features.h"
+
+typedef struct
+{
+	int roiW, roiH;		// window
+	int bW, bH;			// block of the grey subsample
+	int normalize;
+	int stepX, stepY;
+	int threads;		// extraction threads, 0 for one per core
+} ScanSettings;
+
+typedef struct
+{
+	int x, y;			// center of the window
+	int category;
+	int distance;
+} ScanHit;
+
+// recognize the windows of the ROS which fit in it and in the image,
+// row by row; return the number of windows recognized, the first maxHits
+// of which are stored in hits
+int SurveyROS(const IntegralImage* ii, int rosL, int rosT, int rosW, int rosH, const ScanSettings* settings, ScanHit hits[], int maxHits);
+
+#endif
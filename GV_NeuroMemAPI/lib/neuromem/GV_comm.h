@@ -11,12 +11,25 @@
 // for more details regarding this protocol, refer to
 // http://www.general-vision.com/documentation/TM_NeuroMem_Smart_protocol.pdf
 //
+#ifndef _GV_comm_h_
+#define _GV_comm_h_
+
 int Connect(int DeviceID);
 int Disconnect();
 int Read(unsigned char module, unsigned char reg);
 void Write(unsigned char module, unsigned char reg, int value);
 int Write_Addr(int addr, int length_inByte, unsigned char data[]);
 int Read_Addr(int addr, int length_inByte, unsigned char data[]);
+// Same as Write_Addr for 8-bit data: writes length words [0, bytes[i]]
+// expanded directly into the transfer buffer of the comm layer
+// Nothing is sent for a length below 1; the NeuroShield returns 1 past 256 words
+int Write_AddrBytes(int addr, int length, const unsigned char bytes[]);
+// Several write commands sent in a single call
+// frames[] holds the commands back to back, each one made of the 8-byte
+// header of the protocol (board, module + 0x80, addr[15-0], length in words)
+// followed by its data. The Brilliant sends their packets in one bulk
+// transfer, the NeuroShield one SPI transfer per command as Write_Addr.
+int Write_Frames(unsigned char frames[], int length_inByte);
 
 //
 // Definition of the NeuroMem neuron registers
@@ -43,4 +56,96 @@ int Read_Addr(int addr, int length_inByte, unsigned char data[]);
 
 #define DEFMAXIF		0x4000
 #define DEFMINIF		0x0002
-#define DEFGCR			0x01
\ No newline at end of file
+#define DEFGCR			0x01
+
+//
+// Communication statistics
+//
+// Every transaction of the R/W functions above is timed and accounted
+// by the comm_xyz.cpp layer. The counters are always on and cost two clock
+// readings, a few additions and an uncontended lock per transaction; they
+// can be read from any thread.
+// Bytes are split into payload (register data), header (8-byte command)
+// and padding (bytes moved on the bus which carry neither, such as
+// the 512-byte USB packets of the Brilliant platform).
+//
+#define COMM_READ			0
+#define COMM_WRITE			1
+#define COMM_READADDR		2
+#define COMM_WRITEADDR		3
+#define COMM_WRITEFRAMES	4
+#define COMM_CALLTYPES		5
+
+// HDR-style latency histogram in nanoseconds: 16 linear sub-buckets
+// per power of two, about 6% resolution from 16ns up to 2^41ns
+#define COMM_HISTO_SUBBITS	4
+#define COMM_HISTO_BUCKETS	608
+
+typedef struct
+{
+	unsigned long long count;			// number of transactions
+	unsigned long long errors;			// transactions reporting an error
+	unsigned long long timeouts;		// subset of the errors caused by a timeout
+	unsigned long long payloadBytes;
+	unsigned long long headerBytes;
+	unsigned long long paddingBytes;
+	unsigned long long totalNs;
+	unsigned long long minNs;
+	unsigned long long maxNs;
+	unsigned long long histo[COMM_HISTO_BUCKETS];
+} CommCallStats;
+
+typedef struct
+{
+	CommCallStats call[COMM_CALLTYPES];
+} CommStats;
+
+// running totals over all the call types, cheap to sample
+typedef struct
+{
+	unsigned long long count;
+	unsigned long long errors;
+	unsigned long long bytes;			// payload + header + padding
+	unsigned long long payloadBytes;
+	unsigned long long totalNs;
+} CommTotals;
+
+void GetCommStats(CommStats* stats);
+void GetCommTotals(CommTotals* totals);
+void ResetCommStats();
+unsigned long long CommStatsPercentile(const CommCallStats* stats, double percent);
+
+// used by the comm_xyz.cpp layer to time and account a transaction
+long long CommClock();
+void CommStatsRecord(int callType, long long startNs, int payloadBytes, int headerBytes, int paddingBytes, int error, int timeout);
+
+//
+// Recording and replay of the transactions
+//
+// While a recording is open, every transaction is appended to a compact
+// binary log: call type, address, length, data written or read back,
+// start time and duration. CommReplay() sends the same stream to the
+// linked comm_xyz.cpp layer, typically the emulator of comm_simu,
+// and counts the reads returning different data than recorded.
+//
+#define COMM_CONNECT		0x7F // recorded only, not part of the statistics
+
+typedef struct
+{
+	unsigned long long transactions;
+	unsigned long long byType[COMM_CALLTYPES];
+	unsigned long long bytes;			// payload of the replayed transactions
+	unsigned long long mismatches;		// reads returning other data than recorded
+	unsigned long long errors;			// transactions reporting an error on replay
+	unsigned long long recordedNs;		// time spent in the comm layer when recorded
+	unsigned long long replayNs;		// time spent in the comm layer on replay
+} CommReplayStats;
+
+int CommRecordStart(const char* filename);
+void CommRecordStop();
+int CommReplay(const char* filename, CommReplayStats* stats);
+
+// used by the comm_xyz.cpp layer to log a transaction which started at startNs
+void CommRecord(int callType, int addr, int length_inByte, const unsigned char data[], long long startNs, int error);
+
+#endif
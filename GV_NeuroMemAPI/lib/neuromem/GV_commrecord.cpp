@@ -0,0 +1,183 @@
+// GV_commrecord.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Recording of the transactions of the communication layer declared
+// in GV_comm.h into a binary log, and replay of such a log
+//
+// Log format (little-endian):
+//   header  "GVTR", version (1 byte), platform (1 byte), maxveclength (2 bytes)
+//   records tag (1 byte) = call type + 0x80 if the transaction failed
+//           start time since the previous record in ns (varint)
+//           duration in ns (varint)
+//           address (varint)
+//           length in bytes (varint)
+//           data written, or read back (length bytes)
+// varints store 7 bits per byte, least significant group first
+//
+#include "stdio.h"
+#include "stdlib.h"	 //for malloc
+#include "string.h"  //for memcmp
+#include "GV_comm.h"
+
+extern int platform; // initialized in the comm_xyz.cpp
+extern int maxveclength;// initialized in the comm_xyz.cpp
+
+#define RECORD_VERSION		1
+#define RECORD_BUFFER		(1 << 16)
+
+static FILE* recordFile = NULL;
+static long long recordLastNs = 0;
+
+static void PutVarint(FILE* f, unsigned long long value)
+{
+	while (value >= 0x80)
+	{
+		fputc((int)(value & 0x7F) | 0x80, f);
+		value >>= 7;
+	}
+	fputc((int)value, f);
+}
+
+static int GetVarint(FILE* f, unsigned long long* value)
+{
+	*value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		int c = fgetc(f);
+		if (c == EOF) return(1);
+		*value |= (unsigned long long)(c & 0x7F) << shift;
+		if ((c & 0x80) == 0) return(0);
+	}
+	return(1);
+}
+
+// --------------------------------------------------------------
+// Open a log file and start recording
+// return 0 if successful
+// --------------------------------------------------------------
+int CommRecordStart(const char* filename)
+{
+	CommRecordStop();
+	recordFile = fopen(filename, "wb");
+	if (recordFile == NULL) return(1);
+	setvbuf(recordFile, NULL, _IOFBF, RECORD_BUFFER);
+	unsigned char header[8] = { 'G', 'V', 'T', 'R', RECORD_VERSION, 0, 0, 0 };
+	header[5] = (unsigned char)platform;
+	header[6] = (unsigned char)(maxveclength & 0xFF);
+	header[7] = (unsigned char)((maxveclength >> 8) & 0xFF);
+	fwrite(header, 1, 8, recordFile);
+	recordLastNs = CommClock();
+	return(0);
+}
+
+void CommRecordStop()
+{
+	if (recordFile == NULL) return;
+	fclose(recordFile);
+	recordFile = NULL;
+}
+
+// --------------------------------------------------------------
+// Append a transaction to the log, no-op when not recording
+// --------------------------------------------------------------
+void CommRecord(int callType, int addr, int length_inByte, const unsigned char data[], long long startNs, int error)
+{
+	if (recordFile == NULL) return;
+	long long endNs = CommClock();
+	long long delta = startNs - recordLastNs;
+	recordLastNs = startNs;
+	fputc(callType | (error ? 0x80 : 0), recordFile);
+	PutVarint(recordFile, delta > 0 ? delta : 0);
+	PutVarint(recordFile, endNs > startNs ? endNs - startNs : 0);
+	PutVarint(recordFile, (unsigned int)addr);
+	PutVarint(recordFile, length_inByte);
+	if (length_inByte > 0) fwrite(data, 1, length_inByte, recordFile);
+}
+
+// --------------------------------------------------------------
+// Send the transactions of a log to the comm layer
+// return 0 if successful, 1 if the file cannot be opened,
+// 2 if it is not a transaction log, 3 if it is truncated
+// --------------------------------------------------------------
+int CommReplay(const char* filename, CommReplayStats* stats)
+{
+	memset(stats, 0, sizeof(CommReplayStats));
+	FILE* f = fopen(filename, "rb");
+	if (f == NULL) return(1);
+	setvbuf(f, NULL, _IOFBF, RECORD_BUFFER);
+	unsigned char header[8];
+	if ((fread(header, 1, 8, f) != 8) || (memcmp(header, "GVTR", 4) != 0) || (header[4] > RECORD_VERSION))
+	{
+		fclose(f);
+		return(2);
+	}
+	int bufferLength = 1024;
+	unsigned char* recorded = (unsigned char*)malloc(bufferLength);
+	unsigned char* replayed = (unsigned char*)malloc(bufferLength);
+	int error = 0;
+	int tag;
+	while ((tag = fgetc(f)) != EOF)
+	{
+		unsigned long long delta, duration, addr, length;
+		if (GetVarint(f, &delta) || GetVarint(f, &duration) || GetVarint(f, &addr) || GetVarint(f, &length))
+		{
+			error = 3;
+			break;
+		}
+		if ((int)length > bufferLength)
+		{
+			bufferLength = (int)length;
+			recorded = (unsigned char*)realloc(recorded, bufferLength);
+			replayed = (unsigned char*)realloc(replayed, bufferLength);
+		}
+		if (fread(recorded, 1, (size_t)length, f) != length)
+		{
+			error = 3;
+			break;
+		}
+		int callType = tag & 0x7F;
+		unsigned char module = (unsigned char)(addr >> 24);
+		unsigned char reg = (unsigned char)(addr & 0xFF);
+		int status = 0;
+		long long t0 = CommClock();
+		switch (callType)
+		{
+		case COMM_CONNECT:
+			status = Connect((int)addr);
+			break;
+		case COMM_READ:
+		{
+			int data = Read(module, reg);
+			if ((length == 2) && (data != ((recorded[0] << 8) + recorded[1]))) stats->mismatches++;
+			break;
+		}
+		case COMM_WRITE:
+			Write(module, reg, (recorded[0] << 8) + recorded[1]);
+			break;
+		case COMM_READADDR:
+			status = Read_Addr((int)addr, (int)length, replayed);
+			if ((status == 0) && (memcmp(replayed, recorded, (size_t)length) != 0)) stats->mismatches++;
+			break;
+		case COMM_WRITEADDR:
+			status = Write_Addr((int)addr, (int)length, recorded);
+			break;
+		case COMM_WRITEFRAMES:
+			status = Write_Frames(recorded, (int)length);
+			break;
+		default:
+			continue;
+		}
+		stats->replayNs += CommClock() - t0;
+		stats->recordedNs += duration;
+		if (status != 0) stats->errors++;
+		if (callType == COMM_CONNECT) continue;
+		stats->transactions++;
+		stats->byType[callType]++;
+		stats->bytes += length;
+	}
+	free(recorded);
+	free(replayed);
+	fclose(f);
+	return(error);
+}
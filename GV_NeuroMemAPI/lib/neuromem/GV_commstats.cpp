@@ -0,0 +1,125 @@
+// GV_commstats.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Transaction counters and latency histograms of the communication
+// layer declared in GV_comm.h
+//
+#include "string.h"  //for memset
+#include <chrono>
+#include <mutex>
+#include "GV_comm.h"
+
+// the transactions may come from another thread than the readers of the
+// statistics, such as the workers of ReadNeuronsStream or of a pipeline
+static std::mutex commStatsLock;
+static CommStats commStats;
+static CommTotals commTotals;
+
+// --------------------------------------------------------------
+// Monotonic clock in nanoseconds
+// --------------------------------------------------------------
+long long CommClock()
+{
+	return(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// --------------------------------------------------------------
+// Index of the histogram bucket holding a latency value
+// values below 16ns have their own bucket, above that each power
+// of two is split into 16 linear sub-buckets
+// --------------------------------------------------------------
+static int HistoBucket(unsigned long long ns)
+{
+	const int sub = 1 << COMM_HISTO_SUBBITS;
+	if (ns < (unsigned long long)sub) return((int)ns);
+	int msb = 63;
+	while (((ns >> msb) & 1) == 0) msb--;
+	int index = (msb - COMM_HISTO_SUBBITS + 1) * sub + (int)((ns >> (msb - COMM_HISTO_SUBBITS)) & (sub - 1));
+	if (index >= COMM_HISTO_BUCKETS) index = COMM_HISTO_BUCKETS - 1;
+	return(index);
+}
+
+// lowest latency value falling in a bucket
+static unsigned long long HistoBucketValue(int index)
+{
+	const int sub = 1 << COMM_HISTO_SUBBITS;
+	if (index < sub) return((unsigned long long)index);
+	int msb = index / sub + COMM_HISTO_SUBBITS - 1;
+	return((unsigned long long)(sub + (index % sub)) << (msb - COMM_HISTO_SUBBITS));
+}
+
+// --------------------------------------------------------------
+// Account a transaction which started at startNs
+// --------------------------------------------------------------
+void CommStatsRecord(int callType, long long startNs, int payloadBytes, int headerBytes, int paddingBytes, int error, int timeout)
+{
+	long long elapsed = CommClock() - startNs;
+	unsigned long long ns = elapsed > 0 ? (unsigned long long)elapsed : 0;
+	std::lock_guard<std::mutex> guard(commStatsLock);
+	CommCallStats* s = &commStats.call[callType];
+	if (s->count == 0 || ns < s->minNs) s->minNs = ns;
+	if (ns > s->maxNs) s->maxNs = ns;
+	s->count++;
+	s->totalNs += ns;
+	s->payloadBytes += payloadBytes;
+	s->headerBytes += headerBytes;
+	s->paddingBytes += paddingBytes;
+	s->histo[HistoBucket(ns)]++;
+	if (error)
+	{
+		s->errors++;
+		commTotals.errors++;
+		if (timeout) s->timeouts++;
+	}
+	commTotals.count++;
+	commTotals.bytes += payloadBytes + headerBytes + paddingBytes;
+	commTotals.payloadBytes += payloadBytes;
+	commTotals.totalNs += ns;
+}
+
+// --------------------------------------------------------------
+// Snapshot of the statistics since the last reset
+// --------------------------------------------------------------
+void GetCommStats(CommStats* stats)
+{
+	std::lock_guard<std::mutex> guard(commStatsLock);
+	memcpy(stats, &commStats, sizeof(CommStats));
+}
+
+void GetCommTotals(CommTotals* totals)
+{
+	std::lock_guard<std::mutex> guard(commStatsLock);
+	*totals = commTotals;
+}
+
+void ResetCommStats()
+{
+	std::lock_guard<std::mutex> guard(commStatsLock);
+	memset(&commStats, 0, sizeof(CommStats));
+	memset(&commTotals, 0, sizeof(CommTotals));
+}
+
+// --------------------------------------------------------------
+// Latency in nanoseconds below which percent% of the transactions
+// of a call type completed, e.g. percent=99 for the p99
+// --------------------------------------------------------------
+unsigned long long CommStatsPercentile(const CommCallStats* stats, double percent)
+{
+	if (stats->count == 0) return(0);
+	unsigned long long rank = (unsigned long long)(stats->count * percent / 100.0);
+	if (rank >= stats->count) rank = stats->count - 1;
+	unsigned long long seen = 0;
+	for (int i = 0; i < COMM_HISTO_BUCKETS; i++)
+	{
+		seen += stats->histo[i];
+		if (seen > rank)
+		{
+			unsigned long long value = HistoBucketValue(i + 1);
+			if (value > stats->maxNs) value = stats->maxNs;
+			return(value);
+		}
+	}
+	return(stats->maxNs);
+}
@@ -1,14 +1,29 @@
 // NeuroMem.cpp
 // Copyright 2019 General Vision Inc.
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include "stdlib.h"	 //for calloc
 #include "string.h"  //for memcpy
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "GV_comm.h"
+#include "NeuroMem.h"
+#include "NeuroMemProfiler.h"
+#include "NeuroMemKnowledge.h"
+#include "NeuroMemSnapshot.h"
+#include "NeuroMemJournal.h"
 
 extern int platform; // initialized in the comm_xyz.cpp
 extern int maxveclength;// initialized in the comm_xyz.cpp
 
+#define CAT_BURST	256	// CAT registers read per Read_Addr when counting the neurons
+#define JN_BATCH	256	// learnings replayed per LearnBatch
+
+static LearningJournal* journal = NULL; // see SetLearningJournal
+
 
 // --------------------------------------------------------------
 // Initialize communication with the NeuroMem platform and
@@ -16,6 +31,7 @@ extern int maxveclength;// initialized in the comm_xyz.cpp
 // --------------------------------------------------------------
 int InitializeNetwork()
 {
+	NM_PROFILE("InitializeNetwork");
 	int navail = 0;
 	int error=Connect(0);
 	if (error == 0)
@@ -24,13 +40,36 @@ int InitializeNetwork()
 		Write(MOD_NM, NM_NSR, 0x0010);
 		Write(MOD_NM, NM_TESTCAT, 0x0001);
 		Write(MOD_NM, NM_RESETCHAIN, 0);
-		int read_cat;
 		navail = 0;
-		while (1) {
-			read_cat = Read(MOD_NM, NM_CAT);
-			if (read_cat == 0xFFFF)
-				break;
-			navail++;
+		if (platform == 0)
+		{
+			int read_cat;
+			while (1) {
+				read_cat = Read(MOD_NM, NM_CAT);
+				if (read_cat == 0xFFFF)
+					break;
+				navail++;
+			}
+		}
+		else
+		{
+			// each read of CAT moves to the next neuron of the chain,
+			// so the CATs are read by bursts until one returns 0xFFFF
+			unsigned char cats[CAT_BURST * 2];
+			int found = 0;
+			while (!found)
+			{
+				if (Read_Addr(0x01000000 + NM_CAT, CAT_BURST * 2, cats) != 0) break;
+				for (int i = 0; i < CAT_BURST; i++)
+				{
+					if ((cats[i * 2] == 0xFF) && (cats[(i * 2) + 1] == 0xFF))
+					{
+						found = 1;
+						break;
+					}
+					navail++;
+				}
+			}
 		}
 		Write(MOD_NM, NM_NSR, 0x0000);
 		Write(MOD_NM, NM_FORGET, 0);
@@ -38,19 +77,62 @@ int InitializeNetwork()
 	return(navail);
 }
 
+// --------------------------------------------------------------
+// Header of a write command to a register of the neurons, as sent
+// by the comm layer; the data words follow big-endian
+// --------------------------------------------------------------
+static int PutFrame(unsigned char* frame, int reg, int words)
+{
+	frame[0] = 1; //reserved for a board number
+	frame[1] = 0x80 + MOD_NM;
+	frame[2] = 0;
+	frame[3] = 0;
+	frame[4] = (unsigned char)reg;
+	frame[5] = (unsigned char)((words >> 16) & 0xFF);
+	frame[6] = (unsigned char)((words >> 8) & 0xFF);
+	frame[7] = (unsigned char)(words & 0xFF);
+	return(8);
+}
+
+static int PutRegFrame(unsigned char* frame, int reg, int value)
+{
+	int pos = PutFrame(frame, reg, 1);
+	frame[pos++] = (unsigned char)((value >> 8) & 0xFF);
+	frame[pos++] = (unsigned char)(value & 0xFF);
+	return(pos);
+}
+
 // --------------------------------------------------------------
 // Clear the memory of the neurons to the value 0
 // Reset default NM_GCR=1, NM_MINIF=2, MANIF=0x4000, NM_CAT=0
 // --------------------------------------------------------------
 void ClearNeurons()
 {
+	NM_PROFILE("ClearNeurons");
 	Write(1, NM_NSR, 16);
 	Write(1, NM_TESTCAT, 0x0001);
 	Write(1, NM_NSR, 0);
-	for (int i = 0; i< maxveclength; i++)
+	// the INDEXCOMP and TESTCOMP writes of each component, sent at once
+	// to the USB platforms; the SPI platforms still send each write apart
+	unsigned char* frames = (unsigned char*)malloc(maxveclength * 20);
+	if (frames == NULL)
 	{
-		Write(1, NM_INDEXCOMP, i);
-		Write(1, NM_TESTCOMP, 0);
+		for (int i = 0; i < maxveclength; i++)
+		{
+			Write(1, NM_INDEXCOMP, i);
+			Write(1, NM_TESTCOMP, 0);
+		}
+	}
+	else
+	{
+		int pos = 0;
+		for (int i = 0; i < maxveclength; i++)
+		{
+			pos += PutRegFrame(frames + pos, NM_INDEXCOMP, i);
+			pos += PutRegFrame(frames + pos, NM_TESTCOMP, 0);
+		}
+		Write_Frames(frames, pos);
+		free(frames);
 	}
 	Write(1, NM_FORGET, 0);
 }
@@ -60,6 +142,7 @@ void ClearNeurons()
 //----------------------------------------------
 int GetCommitted()
 {
+	NM_PROFILE("GetCommitted");
 	return(Read(MOD_NM, NM_NCOUNT));
 }
 
@@ -67,12 +150,33 @@ int GetCommitted()
 // Uncommit the neurons
 // option to change the default NM_MAXIF
 //----------------------------------------------
+static void JournalForget(int Maxif)
+{
+	if (journal == NULL) return;
+	JournalRecord record;
+	record.type = JN_FORGET;
+	record.length = 0;
+	record.category = 0;
+	record.context = journal->context;
+	record.minif = journal->minif;
+	record.maxif = Maxif;
+	JournalAppend(journal, &record);
+	// FORGET restores the default context
+	journal->context = DEFGCR;
+	journal->minif = DEFMINIF;
+	journal->maxif = Maxif != 0 ? Maxif : DEFMAXIF;
+}
+
 void Forget()
 {
+	NM_PROFILE("Forget");
+	JournalForget(0);
 	Write(MOD_NM,NM_FORGET,0);
 }
 void Forget(int Maxif)
 {
+	NM_PROFILE("Forget");
+	JournalForget(Maxif);
 	Write(MOD_NM,NM_FORGET,0);
 	Write(MOD_NM,NM_MAXIF, Maxif);
 }
@@ -82,6 +186,7 @@ void Forget(int Maxif)
 //---------------------------------------------------------
 int Broadcast(int* vector, int length)
 {
+	NM_PROFILE("Broadcast");
 	if (length>maxveclength) length = maxveclength;
 	if (length == 1) Write(MOD_NM, NM_LCOMP, vector[0]);
 	else
@@ -94,14 +199,36 @@ int Broadcast(int* vector, int length)
 		else
 		{
 			// case of hardware supported Read/Write of packets
-			int l = length * 2;
-			unsigned char* vectorB = new unsigned char[l];
-			for (int i = 0; i < length; i++) 
+			unsigned char vectorB[NM_NEURONSIZE * 2];
+			for (int i = 0; i < length - 1; i++) 
 			{
 				vectorB[i * 2] = 0;
 				vectorB[(i * 2) + 1] = vector[i];
 			}
-			Write_Addr(0x01000001, l - 2, vectorB);
+			Write_Addr(0x01000001, (length - 1) * 2, vectorB);
+		}
+		Write(MOD_NM, NM_LCOMP, vector[length - 1]);
+	}
+	return(Read(MOD_NM, NM_NSR));
+}
+
+int Broadcast(const unsigned char* vector, int length)
+{
+	NM_PROFILE("Broadcast");
+	if (length>maxveclength) length = maxveclength;
+	if (length == 1) Write(MOD_NM, NM_LCOMP, vector[0]);
+	else
+	{
+		if (platform == 0)
+		// case of simulation
+		{
+			for (int i = 0; i < length - 1; i++) Write(MOD_NM, NM_COMP, vector[i]);
+		}
+		else
+		{
+			// case of hardware supported Read/Write of packets,
+			// the comm layer expands the bytes into its transfer buffer
+			Write_AddrBytes(0x01000001, length - 1, vector);
 		}
 		Write(MOD_NM, NM_LCOMP, vector[length - 1]);
 	}
@@ -110,8 +237,38 @@ int Broadcast(int* vector, int length)
 //-----------------------------------------------
 // Learn a vector using the current context value
 //----------------------------------------------
+static void JournalLearn(const unsigned char* vector, int length, int category)
+{
+	JournalRecord record;
+	record.type = JN_LEARN;
+	record.length = length > maxveclength ? maxveclength : length;
+	record.category = category;
+	record.context = journal->context;
+	record.minif = journal->minif;
+	record.maxif = journal->maxif;
+	memcpy(record.vector, vector, record.length);
+	JournalAppend(journal, &record);
+}
+
 int Learn(int* vector, int length, int category)
 {
+	NM_PROFILE("Learn");
+	if (journal != NULL)
+	{
+		unsigned char vectorB[NM_NEURONSIZE];
+		int n = length > NM_NEURONSIZE ? NM_NEURONSIZE : length;
+		for (int i = 0; i < n; i++) vectorB[i] = (unsigned char)vector[i];
+		JournalLearn(vectorB, n, category);
+	}
+	Broadcast(vector, length);
+	Write(MOD_NM, NM_CAT,category);
+	return(Read(MOD_NM,NM_NCOUNT));
+}
+
+int Learn(const unsigned char* vector, int length, int category)
+{
+	NM_PROFILE("Learn");
+	if (journal != NULL) JournalLearn(vector, length, category);
 	Broadcast(vector, length);
 	Write(MOD_NM, NM_CAT,category);
 	return(Read(MOD_NM,NM_NCOUNT));
@@ -120,23 +277,90 @@ int Learn(int* vector, int length, int category)
 // Recognize a vector and return the response of the top firing neuron
 // category (wo/ DEG flag), distance and identifier
 //----------------------------------------------
-int BestMatch(int* vector, int length, int* distance, int* category, int* nid)
+static int ReadBestMatch(int* distance, int* category, int* nid)
 {
-	Broadcast(vector, length);
 	*distance = Read(MOD_NM, NM_DIST);
 	*category= Read(MOD_NM, NM_CAT) & 0x7FFF; 
 	*nid =Read(MOD_NM, NM_NID);
 	return(Read(MOD_NM, NM_NSR));
 }
+
+int BestMatch(int* vector, int length, int* distance, int* category, int* nid)
+{
+	NM_PROFILE("BestMatch");
+	Broadcast(vector, length);
+	return(ReadBestMatch(distance, category, nid));
+}
+
+int BestMatch(const unsigned char* vector, int length, int* distance, int* category, int* nid)
+{
+	NM_PROFILE("BestMatch");
+	Broadcast(vector, length);
+	return(ReadBestMatch(distance, category, nid));
+}
+//----------------------------------------------
+// Recognize count vectors of the same length stored back to back
+// On the hardware platforms, the COMP and LCOMP commands of each vector
+// are staged in one buffer and sent with a single Write_Frames, so the
+// Brilliant broadcasts a vector in one bulk transfer instead of two
+// The status is not read, and neither are the category and identifier
+// of the vectors no neuron recognizes (0xFFFF)
+// Return the number of vectors recognized
+//----------------------------------------------
+int BestMatchBatch(const unsigned char* vectors, int length, int count, int distance[], int category[], int nid[])
+{
+	NM_PROFILE("BestMatchBatch");
+	if (length < 1)
+	{
+		// no vector to broadcast, none is recognized
+		for (int i = 0; i < count; i++) distance[i] = category[i] = nid[i] = 0xFFFF;
+		return(0);
+	}
+	int n = length > maxveclength ? maxveclength : length;
+	unsigned char* frames = NULL;
+	if (platform != 0) frames = (unsigned char*)malloc(8 + (n * 2) + 10);
+	int recognized = 0;
+	for (int i = 0; i < count; i++)
+	{
+		const unsigned char* vector = vectors + ((size_t)i * length);
+		if (frames == NULL) Broadcast(vector, length);
+		else
+		{
+			int pos = 0;
+			if (n > 1)
+			{
+				pos += PutFrame(frames + pos, NM_COMP, n - 1);
+				for (int j = 0; j < n - 1; j++)
+				{
+					frames[pos++] = 0;
+					frames[pos++] = vector[j];
+				}
+			}
+			pos += PutRegFrame(frames + pos, NM_LCOMP, vector[n - 1]);
+			Write_Frames(frames, pos);
+		}
+		distance[i] = Read(MOD_NM, NM_DIST);
+		if (distance[i] == 0xFFFF)
+		{
+			category[i] = 0xFFFF;
+			nid[i] = 0xFFFF;
+			continue;
+		}
+		category[i] = Read(MOD_NM, NM_CAT) & 0x7FFF;
+		nid[i] = Read(MOD_NM, NM_NID);
+		recognized++;
+	}
+	free(frames);
+	return(recognized);
+}
 //----------------------------------------------
 // Recognize a vector and return the response  of up to K top firing neurons
 // The response includes the distance, category and identifier of the neuron
 // The Degenerated flag of the category is masked
 // Return the number of firing neurons or K whichever is smaller
 //----------------------------------------------
-int Recognize(int* vector, int length, int K, int distance[], int category[], int nid[])
+static int ReadFiring(int K, int distance[], int category[], int nid[])
 {
-	Broadcast(vector, length);
 	int recoNbr=0;
 	for (int i=0; i<K; i++)
 	{
@@ -155,23 +379,45 @@ int Recognize(int* vector, int length, int K, int distance[], int category[], in
 	}
 	return(recoNbr);
 }
+
+int Recognize(int* vector, int length, int K, int distance[], int category[], int nid[])
+{
+	NM_PROFILE("Recognize");
+	Broadcast(vector, length);
+	return(ReadFiring(K, distance, category, nid));
+}
+
+int Recognize(const unsigned char* vector, int length, int K, int distance[], int category[], int nid[])
+{
+	NM_PROFILE("Recognize");
+	Broadcast(vector, length);
+	return(ReadFiring(K, distance, category, nid));
+}
 // ------------------------------------------------------------ 
 // Set a context and associated minimum and maximum influence fields
 // ------------------------------------------------------------ 
 void setContext(int context, int minif, int maxif)
 {
+	NM_PROFILE("setContext");
 	// context[15-8]= unused
 	// context[7]= Norm (0 for L1; 1 for LSup)
 	// context[6-0]= Active context value
 	Write(MOD_NM, NM_GCR, context);
 	Write(MOD_NM, NM_MINIF, minif);
 	Write(MOD_NM, NM_MAXIF, maxif);
+	if (journal != NULL)
+	{
+		journal->context = context;
+		journal->minif = minif;
+		journal->maxif = maxif;
+	}
 }
 // ------------------------------------------------------------ 
 // Get a context and associated minimum and maximum influence fields
 // ------------------------------------------------------------ 
 void getContext(int* context, int* minif, int* maxif)
 {
+	NM_PROFILE("getContext");
 	// context[15-8]= unused
 	// context[7]= Norm (0 for L1; 1 for LSup)
 	// context[6-0]= Active context value
@@ -184,6 +430,7 @@ void getContext(int* context, int* minif, int* maxif)
 //---------------------------------------------------------
 void setRBF()
 {
+	NM_PROFILE("setRBF");
 	int tempNSR = Read(MOD_NM, NM_NSR);
 	Write(MOD_NM, NM_NSR, tempNSR & 0xDF);
 }
@@ -192,10 +439,32 @@ void setRBF()
 //---------------------------------------------------------
 void setKNN()
 {
+	NM_PROFILE("setKNN");
 	int tempNSR = Read(MOD_NM, NM_NSR);
 	Write(MOD_NM, NM_NSR, tempNSR | 0x20);
 }
 
+//-------------------------------------------------------------
+// Read the next neuron of the chain in Save and Restore mode
+//-------------------------------------------------------------
+static void ReadNextNeuron(NeuronRecord* neuron, unsigned char* modelB)
+{
+	neuron->context = (unsigned short)Read(MOD_NM, NM_NCR);
+	if (platform == 0)
+	{
+		for (int i = 0; i < maxveclength; i++) neuron->model[i] = (unsigned char)Read(MOD_NM, NM_COMP);
+	}
+	else
+	{
+		Read_Addr(0x01000001, maxveclength * 2, modelB);
+		for (int i = 0; i < maxveclength; i++) neuron->model[i] = modelB[i * 2 + 1];
+	}
+	for (int i = maxveclength; i < NM_NEURONSIZE; i++) neuron->model[i] = 0;
+	neuron->aif = (unsigned short)Read(MOD_NM, NM_AIF);
+	neuron->minif = (unsigned short)Read(MOD_NM, NM_MINIF);
+	neuron->cat = (unsigned short)Read(MOD_NM, NM_CAT);
+}
+
 //--------------------------------------------------------------------------------------
 // Read the content of a specific neuron
 // Warning: neuuons are indexed in the chain starting at 1
@@ -203,6 +472,7 @@ void setKNN()
 //--------------------------------------------------------------------------------------
 void ReadNeuron(int neuronID, int* ncr, int model[], int* aif, int* minif, int* category)
 {
+	NM_PROFILE("ReadNeuron");
 	int ncount = Read(1, NM_NCOUNT);
 	if ((neuronID <= 0) | (neuronID > ncount))
 	{
@@ -235,6 +505,7 @@ void ReadNeuron(int neuronID, int* ncr, int model[], int* aif, int* minif, int*
 
 void ReadNeuron(int neuronID, int neuron[])
 {
+	NM_PROFILE("ReadNeuron");
 	int ncount = Read(1, NM_NCOUNT);
 	if ((neuronID <= 0) | (neuronID > ncount))
 	{
@@ -263,11 +534,30 @@ void ReadNeuron(int neuronID, int neuron[])
 	Write(1, NM_NSR, TempNSR);
 	return;
 }
+
+void ReadNeuron(int neuronID, NeuronRecord* neuron)
+{
+	NM_PROFILE("ReadNeuron");
+	int ncount = Read(MOD_NM, NM_NCOUNT);
+	if ((neuronID <= 0) | (neuronID > ncount))
+	{
+		memset(neuron, 0, sizeof(NeuronRecord));
+		return;
+	}
+	unsigned char modelB[NM_NEURONSIZE * 2];
+	int TempNSR = Read(MOD_NM, NM_NSR);
+	Write(MOD_NM, NM_NSR, 0x0010);
+	Write(MOD_NM, NM_RESETCHAIN, 0);
+	for (int i = 0; i < neuronID - 1; i++) Read(MOD_NM, NM_CAT);
+	ReadNextNeuron(neuron, modelB);
+	Write(MOD_NM, NM_NSR, TempNSR);
+}
 //-------------------------------------------------------------
 // Read the contents of the neurons
 //-------------------------------------------------------------
 int ReadNeurons(int *neurons)
 {
+	NM_PROFILE("ReadNeurons");
 	int ncount = Read(1, NM_NCOUNT);
 	memset(neurons,0, ncount*(maxveclength + 4)*sizeof(int));
 	int* neuron=new int[maxveclength+4];
@@ -299,11 +589,101 @@ int ReadNeurons(int *neurons)
 		return(ncount);
 	}
 }
+
+int ReadNeurons(NeuronRecord neurons[])
+{
+	NM_PROFILE("ReadNeurons");
+	int ncount = Read(MOD_NM, NM_NCOUNT);
+	if (ncount == 0) return(0);
+	unsigned char modelB[NM_NEURONSIZE * 2];
+	int TempNSR = Read(MOD_NM, NM_NSR);
+	Write(MOD_NM, NM_NSR, 0x0010);
+	Write(MOD_NM, NM_RESETCHAIN, 0);
+	for (int i = 0; i < ncount; i++) ReadNextNeuron(&neurons[i], modelB);
+	Write(MOD_NM, NM_NSR, TempNSR);
+	return(ncount);
+}
+//-------------------------------------------------------------
+// Export the contents of the neurons to a sink, chunk neurons at a time
+// Two chunk buffers are used in turn: the sink runs on a worker thread
+// with one of them while the next chunk is read from the device into
+// the other, so the memory used does not depend on the number of neurons.
+// The export stops early if the sink returns non-zero.
+// return the number of neurons passed to the sink
+//-------------------------------------------------------------
+int ReadNeuronsStream(int chunk, NeuronSink sink, void* user)
+{
+	NM_PROFILE("ReadNeuronsStream");
+	if (chunk < 1) chunk = 1;
+	int ncount = Read(MOD_NM, NM_NCOUNT);
+	if (ncount == 0) return(0);
+
+	NeuronRecord* buffers[2];
+	buffers[0] = (NeuronRecord*)malloc(chunk * sizeof(NeuronRecord));
+	buffers[1] = (NeuronRecord*)malloc(chunk * sizeof(NeuronRecord));
+	unsigned char* modelB = (unsigned char*)malloc(maxveclength * 2);
+	int first[2] = { 0, 0 }, count[2] = { 0, 0 };
+	bool full[2] = { false, false };
+	bool done = false, stop = false;
+	int exported = 0;
+	std::mutex lock;
+	std::condition_variable changed;
+
+	std::thread consumer([&]()
+	{
+		for (int b = 0; ; b ^= 1)
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			changed.wait(guard, [&] { return full[b] || done; });
+			if (!full[b]) return;
+			guard.unlock();
+			int result = sink(buffers[b], first[b], count[b], user);
+			guard.lock();
+			exported += count[b];
+			full[b] = false;
+			if (result != 0) stop = true;
+			changed.notify_all();
+			if (stop) return;
+		}
+	});
+
+	int TempNSR = Read(MOD_NM, NM_NSR);
+	Write(MOD_NM, NM_NSR, 0x0010);
+	Write(MOD_NM, NM_RESETCHAIN, 0);
+	for (int n = 0, b = 0; n < ncount; n += chunk, b ^= 1)
+	{
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			changed.wait(guard, [&] { return !full[b] || stop; });
+			if (stop) break;
+		}
+		int c = ncount - n < chunk ? ncount - n : chunk;
+		for (int i = 0; i < c; i++) ReadNextNeuron(&buffers[b][i], modelB);
+		std::lock_guard<std::mutex> guard(lock);
+		first[b] = n;
+		count[b] = c;
+		full[b] = true;
+		changed.notify_all();
+	}
+	Write(MOD_NM, NM_NSR, TempNSR);
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		done = true;
+		changed.notify_all();
+	}
+	consumer.join();
+	free(buffers[0]);
+	free(buffers[1]);
+	free(modelB);
+	return(exported);
+}
+
 //-------------------------------------------------------------
 // load the neurons' content from file
 //-------------------------------------------------------------
 int WriteNeurons(int *neurons, int ncount)
 {
+	NM_PROFILE("WriteNeurons");
 	int TempNSR = Read(1, NM_NSR);
 	ClearNeurons();
 	Write(1, NM_NSR, 0x0010);
@@ -333,6 +713,414 @@ int WriteNeurons(int *neurons, int ncount)
 	return(Read(1, NM_NCOUNT));
 }
 
+int WriteNeurons(const NeuronRecord neurons[], int ncount)
+{
+	return(WriteNeuronsBulk(neurons, ncount, NULL));
+}
+
+// --------------------------------------------------------------
+// Size of the frame buffer used to write NM_BULKBYTES of neurons at once
+// --------------------------------------------------------------
+static int BulkNeuronBytes()
+{
+	return((4 * 10) + 8 + (maxveclength * 2));
+}
+
+static int BulkNeuronsPerTransfer()
+{
+	int perTransfer = NM_BULKBYTES / BulkNeuronBytes();
+	return(perTransfer < 1 ? 1 : perTransfer);
+}
+
+// --------------------------------------------------------------
+// Write neurons at the current position of the chain in Save and Restore mode
+// Each neuron is the sequence of write commands of WriteNeurons
+// (NCR, COMP x maxveclength, AIF, MINIF, CAT) and the commands of up to
+// NM_BULKBYTES are sent at once with Write_Frames.
+// frames holds BulkNeuronsPerTransfer() * BulkNeuronBytes() bytes
+// --------------------------------------------------------------
+static void WriteNextNeurons(const NeuronRecord neurons[], int ncount, unsigned char* frames)
+{
+	if (platform == 0)
+	{
+		for (int i = 0; i < ncount; i++)
+		{
+			Write(MOD_NM, NM_NCR, neurons[i].context);
+			for (int j = 0; j < maxveclength; j++) Write(MOD_NM, NM_COMP, neurons[i].model[j]);
+			Write(MOD_NM, NM_AIF, neurons[i].aif);
+			Write(MOD_NM, NM_MINIF, neurons[i].minif);
+			Write(MOD_NM, NM_CAT, neurons[i].cat);
+		}
+		return;
+	}
+	int perTransfer = BulkNeuronsPerTransfer();
+	for (int first = 0; first < ncount; first += perTransfer)
+	{
+		int last = first + perTransfer < ncount ? first + perTransfer : ncount;
+		int pos = 0;
+		for (int i = first; i < last; i++)
+		{
+			pos += PutRegFrame(frames + pos, NM_NCR, neurons[i].context);
+			pos += PutFrame(frames + pos, NM_COMP, maxveclength);
+			for (int j = 0; j < maxveclength; j++)
+			{
+				frames[pos++] = 0;
+				frames[pos++] = neurons[i].model[j];
+			}
+			pos += PutRegFrame(frames + pos, NM_AIF, neurons[i].aif);
+			pos += PutRegFrame(frames + pos, NM_MINIF, neurons[i].minif);
+			pos += PutRegFrame(frames + pos, NM_CAT, neurons[i].cat);
+		}
+		Write_Frames(frames, pos);
+	}
+}
+
+// --------------------------------------------------------------
+// Load the neurons from compact records, several neurons per transfer
+// neuronsPerSec, if not NULL, receives the load throughput
+// return the number of committed neurons
+// --------------------------------------------------------------
+int WriteNeuronsBulk(const NeuronRecord neurons[], int ncount, double* neuronsPerSec)
+{
+	NM_PROFILE("WriteNeuronsBulk");
+	long long t0 = CommClock();
+	int TempNSR = Read(MOD_NM, NM_NSR);
+	ClearNeurons();
+	Write(MOD_NM, NM_NSR, 0x0010);
+	Write(MOD_NM, NM_RESETCHAIN, 0);
+	unsigned char* frames = (unsigned char*)malloc(BulkNeuronsPerTransfer() * BulkNeuronBytes());
+	WriteNextNeurons(neurons, ncount, frames);
+	free(frames);
+	Write(MOD_NM, NM_NSR, TempNSR);
+	int ncommitted = Read(MOD_NM, NM_NCOUNT);
+	if (neuronsPerSec != NULL)
+	{
+		long long ns = CommClock() - t0;
+		*neuronsPerSec = ns > 0 ? (ncount * 1e9) / ns : 0.0;
+	}
+	return(ncommitted);
+}
+
+// --------------------------------------------------------------
+// Learn count vectors of the same length stored back to back
+// On the hardware platforms, the commands of a learning (COMP x length-1,
+// LCOMP and CAT) are sent by up to NM_BULKBYTES with Write_Frames
+// return the number of committed neurons
+// --------------------------------------------------------------
+int LearnBatch(const unsigned char* vectors, int length, int count, const int categories[])
+{
+	NM_PROFILE("LearnBatch");
+	// n components are learned, the vectors are length apart
+	int n = length > maxveclength ? maxveclength : length;
+	if (n < 1) return(Read(MOD_NM, NM_NCOUNT));
+	if (journal != NULL)
+	{
+		for (int i = 0; i < count; i++) JournalLearn(vectors + ((size_t)i * length), n, categories[i]);
+	}
+	int perTransfer = BulkNeuronsPerTransfer();
+	unsigned char* frames = NULL;
+	if (platform != 0) frames = (unsigned char*)malloc(perTransfer * BulkNeuronBytes());
+	if (frames == NULL)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			Broadcast(vectors + ((size_t)i * length), n);
+			Write(MOD_NM, NM_CAT, categories[i]);
+		}
+		return(Read(MOD_NM, NM_NCOUNT));
+	}
+	for (int first = 0; first < count; first += perTransfer)
+	{
+		int last = first + perTransfer < count ? first + perTransfer : count;
+		int pos = 0;
+		for (int i = first; i < last; i++)
+		{
+			const unsigned char* vector = vectors + ((size_t)i * length);
+			if (n > 1)
+			{
+				pos += PutFrame(frames + pos, NM_COMP, n - 1);
+				for (int j = 0; j < n - 1; j++)
+				{
+					frames[pos++] = 0;
+					frames[pos++] = vector[j];
+				}
+			}
+			pos += PutRegFrame(frames + pos, NM_LCOMP, vector[n - 1]);
+			pos += PutRegFrame(frames + pos, NM_CAT, categories[i]);
+		}
+		Write_Frames(frames, pos);
+	}
+	free(frames);
+	return(Read(MOD_NM, NM_NCOUNT));
+}
+
+// --------------------------------------------------------------
+// Knowledge files, see NeuroMemKnowledge.h for the formats
+// --------------------------------------------------------------
+#define KN_CHUNK		256		// neurons per file read or write
+
+// sink of ReadNeuronsStream appending the records to the file
+static int WriteKnowledgeChunk(const NeuronRecord neurons[], int /*first*/, int count, void* user)
+{
+	return(KnowledgeWrite((KnowledgeFile*)user, neurons, count));
+}
+
+// write the neurons to a created file, a short export is an error
+static void WriteKnowledgeRecords(KnowledgeFile* kn)
+{
+	int exported = ReadNeuronsStream(KN_CHUNK, WriteKnowledgeChunk, kn);
+	if ((kn->error == 0) && (exported != kn->ncount)) kn->error = KN_ERROR_TRUNCATED;
+}
+
+// --------------------------------------------------------------
+// Save the content of the neurons to a knowledge file
+// The neurons are read from the device while the previous chunk is written
+// return 0 if successful or an error KN_ERROR_xyz
+// --------------------------------------------------------------
+int SaveKnowledge(const char* filename)
+{
+	return(SaveKnowledge(filename, KN_FORMAT, 0));
+}
+
+int SaveKnowledge(const char* filename, int format, int flags)
+{
+	NM_PROFILE("SaveKnowledge");
+	KnowledgeFile kn;
+	int error = KnowledgeCreate(&kn, filename, format, flags, Read(MOD_NM, NM_NCOUNT));
+	if (error == 0) WriteKnowledgeRecords(&kn);
+	int closeError = KnowledgeClose(&kn);
+	return(error != 0 ? error : closeError);
+}
+
+// --------------------------------------------------------------
+// Load the neurons with the content of a knowledge file of either format
+// The records are decoded and sent with the bulk transfers, KN_CHUNK at a time
+// return 0 if successful or an error KN_ERROR_xyz
+// --------------------------------------------------------------
+static int LoadRecords(KnowledgeFile* kn)
+{
+	NeuronRecord* neurons = (NeuronRecord*)malloc(KN_CHUNK * sizeof(NeuronRecord));
+	unsigned char* frames = (unsigned char*)malloc(BulkNeuronsPerTransfer() * BulkNeuronBytes());
+	int TempGCR = Read(MOD_NM, NM_GCR);
+	int TempNSR = Read(MOD_NM, NM_NSR);
+	ClearNeurons();
+	Write(MOD_NM, NM_NSR, 0x0010);
+	Write(MOD_NM, NM_RESETCHAIN, 0);
+	int loaded = 0, count;
+	while ((count = KnowledgeRead(kn, neurons, KN_CHUNK)) > 0)
+	{
+		WriteNextNeurons(neurons, count, frames);
+		loaded += count;
+	}
+	Write(MOD_NM, NM_NSR, TempNSR);
+	Write(MOD_NM, NM_GCR, TempGCR);
+	if ((kn->error == 0) && (loaded < kn->ncount)) kn->error = KN_ERROR_TRUNCATED;
+	int error = KnowledgeClose(kn);
+	if ((error == 0) && (Read(MOD_NM, NM_NCOUNT) < loaded)) error = KN_ERROR_CAPACITY;
+	free(neurons);
+	free(frames);
+	return(error);
+}
+
+int LoadKnowledge(const char* filename)
+{
+	NM_PROFILE("LoadKnowledge");
+	KnowledgeFile kn;
+	int error = KnowledgeOpen(&kn, filename);
+	if (error != 0) return(error);
+	return(LoadRecords(&kn));
+}
+
+// --------------------------------------------------------------
+// Save the neurons and the feature extraction settings to a CogniSight
+// project file, compatible with the CogniSight SDK and the Arduino library
+// minif and maxif are the ones of the network
+// --------------------------------------------------------------
+int SaveProject(const char* filename, const ProjectSettings* settings)
+{
+	NM_PROFILE("SaveProject");
+	ProjectSettings saved = *settings;
+	saved.minif = Read(MOD_NM, NM_MINIF);
+	saved.maxif = Read(MOD_NM, NM_MAXIF);
+	KnowledgeFile kn;
+	int error = KnowledgeCreateProject(&kn, filename, &saved, Read(MOD_NM, NM_NCOUNT));
+	if (error == 0) WriteKnowledgeRecords(&kn);
+	int closeError = KnowledgeClose(&kn);
+	return(error != 0 ? error : closeError);
+}
+
+// --------------------------------------------------------------
+// Load the neurons of a CogniSight project file with the bulk transfers
+// and return its feature extraction settings; MINIF and MAXIF are applied
+// to the network once the neurons are loaded
+// return 0 if successful or an error KN_ERROR_xyz
+// --------------------------------------------------------------
+int LoadProject(const char* filename, ProjectSettings* settings)
+{
+	NM_PROFILE("LoadProject");
+	KnowledgeFile kn;
+	int error = KnowledgeOpenProject(&kn, filename, settings);
+	if (error != 0) return(error);
+	error = LoadRecords(&kn);
+	// the settings go with the neurons, a failed load leaves the network ones
+	if (error != 0) return(error);
+	Write(MOD_NM, NM_MINIF, settings->minif);
+	Write(MOD_NM, NM_MAXIF, settings->maxif);
+	return(0);
+}
+
+// --------------------------------------------------------------
+// Append a snapshot to a log, see NeuroMemSnapshot.h
+// The neurons known by the log are swept with two register reads each
+// (AIF and CAT) and only the changed ones are logged, followed by the
+// neurons committed since the previous snapshot. A base snapshot of all
+// the neurons is written when full is set, for the first snapshot of the
+// log, or when the network holds fewer neurons than the log.
+// return 0 if successful or an error KN_ERROR_xyz
+// --------------------------------------------------------------
+int SaveSnapshot(SnapshotLog* log, int full)
+{
+	NM_PROFILE("SaveSnapshot");
+	int ncount = Read(MOD_NM, NM_NCOUNT);
+	int known = (full || (log->snapshots == 0) || (ncount < log->ncount)) ? 0 : log->ncount;
+	unsigned int* index = (unsigned int*)malloc(((size_t)known + 1) * sizeof(unsigned int));
+	unsigned short* aifCat = (unsigned short*)malloc(((size_t)known + 1) * 2 * sizeof(unsigned short));
+	NeuronRecord* neurons = (NeuronRecord*)malloc(KN_CHUNK * sizeof(NeuronRecord));
+	unsigned char* modelB = (unsigned char*)malloc(maxveclength * 2);
+	int TempNSR = Read(MOD_NM, NM_NSR);
+	Write(MOD_NM, NM_NSR, 0x0010);
+	Write(MOD_NM, NM_RESETCHAIN, 0);
+	int changed = 0;
+	for (int i = 0; i < known; i++)
+	{
+		int aif = Read(MOD_NM, NM_AIF);
+		int cat = Read(MOD_NM, NM_CAT);
+		const unsigned short* regs = log->regs + ((size_t)i * 4);
+		if ((aif == regs[1]) && (cat == regs[3])) continue;
+		index[changed] = i;
+		aifCat[changed * 2] = (unsigned short)aif;
+		aifCat[(changed * 2) + 1] = (unsigned short)cat;
+		changed++;
+	}
+	int error = SnapshotBegin(log, known == 0 ? SN_BASE : 0, changed, index, aifCat);
+	for (int n = known; (n < ncount) && (error == 0); n += KN_CHUNK)
+	{
+		int count = ncount - n < KN_CHUNK ? ncount - n : KN_CHUNK;
+		for (int i = 0; i < count; i++) ReadNextNeuron(&neurons[i], modelB);
+		error = SnapshotAdd(log, neurons, count);
+	}
+	Write(MOD_NM, NM_NSR, TempNSR);
+	if (error == 0) error = SnapshotEnd(log);
+	// the learnings of the journal are now on the device in the log,
+	// SnapshotEnd returns once the snapshot is synced
+	if ((error == 0) && (journal != NULL)) error = JournalReset(journal);
+	free(index);
+	free(aifCat);
+	free(neurons);
+	free(modelB);
+	return(error);
+}
+
+// --------------------------------------------------------------
+// Load the neurons of the last snapshot of a log with the bulk transfers
+// return 0 if successful or an error KN_ERROR_xyz
+// --------------------------------------------------------------
+int LoadSnapshot(SnapshotLog* log)
+{
+	NM_PROFILE("LoadSnapshot");
+	NeuronRecord* neurons = (NeuronRecord*)malloc(KN_CHUNK * sizeof(NeuronRecord));
+	unsigned char* frames = (unsigned char*)malloc(BulkNeuronsPerTransfer() * BulkNeuronBytes());
+	int TempGCR = Read(MOD_NM, NM_GCR);
+	int TempNSR = Read(MOD_NM, NM_NSR);
+	ClearNeurons();
+	Write(MOD_NM, NM_NSR, 0x0010);
+	Write(MOD_NM, NM_RESETCHAIN, 0);
+	int loaded = 0, count;
+	while ((count = SnapshotRead(log, loaded, neurons, KN_CHUNK)) > 0)
+	{
+		WriteNextNeurons(neurons, count, frames);
+		loaded += count;
+	}
+	Write(MOD_NM, NM_NSR, TempNSR);
+	Write(MOD_NM, NM_GCR, TempGCR);
+	int error = log->error;
+	if ((error == 0) && (Read(MOD_NM, NM_NCOUNT) < loaded)) error = KN_ERROR_CAPACITY;
+	free(neurons);
+	free(frames);
+	return(error);
+}
+
+// --------------------------------------------------------------
+// Learning journal, see NeuroMemJournal.h
+// The context of the network is read once, then followed by setContext
+// and Forget
+// --------------------------------------------------------------
+void SetLearningJournal(LearningJournal* learningJournal)
+{
+	journal = learningJournal;
+	if (journal != NULL) getContext(&journal->context, &journal->minif, &journal->maxif);
+}
+
+// --------------------------------------------------------------
+// Restore the network after a reset: load the last snapshot of log, or
+// start from an empty network if log is NULL, and replay the journal
+// Consecutive learnings of the same context and length are replayed
+// together with LearnBatch
+// return 0 if successful or an error KN_ERROR_xyz
+// --------------------------------------------------------------
+int RecoverLearning(SnapshotLog* log, LearningJournal* learningJournal, RecoveryStats* stats)
+{
+	NM_PROFILE("RecoverLearning");
+	memset(stats, 0, sizeof(RecoveryStats));
+	LearningJournal* active = journal;
+	journal = NULL; // the replay is not journaled again
+	long long t0 = CommClock();
+	int error = 0;
+	if (log != NULL) error = LoadSnapshot(log);
+	else ClearNeurons();
+	stats->restored = Read(MOD_NM, NM_NCOUNT);
+	long long t1 = CommClock();
+
+	unsigned char* vectors = (unsigned char*)malloc(JN_BATCH * NM_NEURONSIZE);
+	int categories[JN_BATCH];
+	JournalRecord record, batch;
+	memset(&batch, 0, sizeof(JournalRecord));
+	int count = 0;
+	unsigned long long offset = JN_HEADERSIZE;
+	while (error == 0)
+	{
+		bool more = JournalRead(learningJournal, &offset, &record) == 0;
+		bool same = more && (record.type == JN_LEARN) && (record.length == batch.length) && (record.context == batch.context)
+			&& (record.minif == batch.minif) && (record.maxif == batch.maxif);
+		if ((count > 0) && (!same || (count == JN_BATCH)))
+		{
+			LearnBatch(vectors, batch.length, count, categories);
+			count = 0;
+		}
+		if (!more) break;
+		stats->replayed++;
+		if (record.type == JN_FORGET)
+		{
+			if (record.maxif != 0) Forget(record.maxif);
+			else Forget();
+			continue;
+		}
+		if (count == 0)
+		{
+			batch = record;
+			setContext(record.context, record.minif, record.maxif);
+		}
+		memcpy(vectors + ((size_t)count * record.length), record.vector, record.length);
+		categories[count++] = record.category;
+	}
+	free(vectors);
+	stats->committed = Read(MOD_NM, NM_NCOUNT);
+	long long t2 = CommClock();
+	stats->snapshotMs = (t1 - t0) / 1e6;
+	stats->replayMs = (t2 - t1) / 1e6;
+	SetLearningJournal(active);
+	return(error);
+}
 
 // --------------------------------------------------------------
 // Functions for interfacing with integer pointers in python
@@ -1,6 +1,9 @@
 // NeuroMem.h
 // copyright 2019 General Vision Inc.
 
+#ifndef _NeuroMem_h_
+#define _NeuroMem_h_
+
 int InitializeNetwork();
 void Forget();
 void Forget(int Maxif);
@@ -13,6 +16,17 @@ int Learn(int* vector, int length, int category);
 int BestMatch(int* vector, int length, int* distance, int* category, int* nid);
 int Recognize(int* vector, int length, int K, int distance[], int category[], int nid[]);
 
+//Same operations on vectors of 8-bit components
+int Broadcast(const unsigned char* vector, int length);
+int Learn(const unsigned char* vector, int length, int category);
+int BestMatch(const unsigned char* vector, int length, int* distance, int* category, int* nid);
+int Recognize(const unsigned char* vector, int length, int K, int distance[], int category[], int nid[]);
+
+//Learning and recognition of count vectors of the same length stored back to back
+int LearnBatch(const unsigned char* vectors, int length, int count, const int categories[]);
+// return the number of vectors recognized, the others have a distance of 0xFFFF
+int BestMatchBatch(const unsigned char* vectors, int length, int count, int distance[], int category[], int nid[]);
+
 void setContext(int context, int minif, int maxif);
 void getContext(int* context, int* minif, int* maxif);
 void setRBF();
@@ -24,7 +38,82 @@ int WriteNeurons(int *neurons, int ncount);
 void ReadNeuron(int nid, int neuron[]);
 void ReadNeuron(int nid, int* ncr, int model[], int* aif, int* minif, int* category);
 
+//Compact neuron record, 264 bytes instead of (maxveclength + 4) ints
+#define NM_NEURONSIZE	256		// memory of a neuron in bytes
+#define NM_BULKBYTES	(1 << 16)	// size of the bulk transfers
+#define NM_MAXNEURONS	(1 << 20)	// largest network, the one of the emulator
+
+typedef struct
+{
+	unsigned short context;		// NCR
+	unsigned short aif;
+	unsigned short minif;
+	unsigned short cat;
+	unsigned char model[NM_NEURONSIZE];
+} NeuronRecord;
+
+int ReadNeurons(NeuronRecord neurons[]);
+int WriteNeurons(const NeuronRecord neurons[], int ncount);
+void ReadNeuron(int nid, NeuronRecord* neuron);
+int WriteNeuronsBulk(const NeuronRecord neurons[], int ncount, double* neuronsPerSec);
+
+// Receives the neurons exported by ReadNeuronsStream, count neurons starting
+// at index first of the chain (0-based). Called from a worker thread, the
+// records are only valid during the call. Return non-zero to stop the export.
+typedef int (*NeuronSink)(const NeuronRecord neurons[], int first, int count, void* user);
+int ReadNeuronsStream(int chunk, NeuronSink sink, void* user);
+
+//Knowledge files, see NeuroMemKnowledge.h for the formats
+#define KN_FORMAT		0x1704	// format of the SD card files of the Arduino library
+#define KN_COMPACT		2		// compact format, version 2
+#define KN_COMPRESS		0x0001	// flag of the compact format, compressed models
+int SaveKnowledge(const char* filename);
+int SaveKnowledge(const char* filename, int format, int flags);
+// the format of the file is detected
+int LoadKnowledge(const char* filename);
+
+//CogniSight projects (.csp): the knowledge and the settings of the feature
+//extraction which produced the models
+typedef struct
+{
+	int width;			// region of interest
+	int height;
+	int featID;
+	int normalized;
+	int featParam1;		// block width
+	int featParam2;		// block height
+	int minif;			// of the network, read from the device on save
+	int maxif;
+} ProjectSettings;
+int SaveProject(const char* filename, const ProjectSettings* settings);
+// loads the neurons, then applies minif and maxif to the network if successful
+int LoadProject(const char* filename, ProjectSettings* settings);
+
+//Incremental snapshots in an append-only log, see NeuroMemSnapshot.h
+//for the opening and the compaction of the log
+struct SnapshotLog;
+// full writes all the neurons instead of the changes since the last snapshot
+int SaveSnapshot(SnapshotLog* log, int full);
+int LoadSnapshot(SnapshotLog* log);
+
+//Write-ahead journal of the learnings, see NeuroMemJournal.h
+struct LearningJournal;
+// NULL stops the journaling
+void SetLearningJournal(LearningJournal* journal);
+typedef struct
+{
+	int restored;		// neurons of the snapshot
+	int replayed;		// records of the journal
+	int committed;		// neurons after the replay
+	double snapshotMs;	// time to load the snapshot
+	double replayMs;	// time to replay the journal
+} RecoveryStats;
+// log can be NULL to replay the journal on an empty network
+int RecoverLearning(SnapshotLog* log, LearningJournal* journal, RecoveryStats* stats);
+
 // for compatibility with pointers in python
 //int *new_int(int ivalue);
 //int get_int(int *i);
-//void delete_int(int *i);
\ No newline at end of file
+//void delete_int(int *i);
+
+#endif
@@ -0,0 +1,165 @@
+// NeuroMemJournal.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Write-ahead learning journal described in NeuroMemJournal.h
+//
+#ifdef _WIN32
+#include <io.h>		// _commit
+#else
+#include <unistd.h>	// fsync
+#endif
+#include "stdlib.h"	 //for malloc
+#include "string.h"  //for memcpy
+#include "GV_comm.h"
+#include "NeuroMemJournal.h"
+
+#define JN_VERSION		1
+
+static void Put16(unsigned char* p, unsigned int value)
+{
+	p[0] = (unsigned char)(value & 0xFF);
+	p[1] = (unsigned char)((value >> 8) & 0xFF);
+}
+
+static unsigned int Get16(const unsigned char* p)
+{
+	return(p[0] + (p[1] << 8));
+}
+
+static int WriteHeader(LearningJournal* journal)
+{
+	unsigned char header[JN_HEADERSIZE];
+	memset(header, 0, JN_HEADERSIZE);
+	memcpy(header, "GVJN", 4);
+	Put16(header + 4, JN_VERSION);
+	if (fwrite(header, 1, JN_HEADERSIZE, journal->f) != JN_HEADERSIZE) return(KN_ERROR_WRITE);
+	journal->length = JN_HEADERSIZE;
+	journal->records = 0;
+	return(JournalSync(journal));
+}
+
+// --------------------------------------------------------------
+// Open a journal, the next records are appended after its last
+// complete one
+// --------------------------------------------------------------
+int JournalOpen(LearningJournal* journal, const char* filename, int groupRecords, int groupMs)
+{
+	memset(journal, 0, sizeof(LearningJournal));
+	journal->filename = (char*)malloc(strlen(filename) + 1);
+	if (journal->filename == NULL) return(journal->error = KN_ERROR_MEMORY);
+	strcpy(journal->filename, filename);
+	journal->groupRecords = groupRecords < 1 ? 1 : groupRecords;
+	journal->groupNs = (long long)groupMs * 1000000;
+	journal->context = DEFGCR;
+	journal->minif = DEFMINIF;
+	journal->maxif = DEFMAXIF;
+	journal->f = fopen(filename, "r+b");
+	if (journal->f == NULL)
+	{
+		journal->f = fopen(filename, "w+b");
+		if (journal->f == NULL) return(journal->error = KN_ERROR_OPEN);
+		return(journal->error = WriteHeader(journal));
+	}
+	unsigned char header[JN_HEADERSIZE];
+	if (fread(header, 1, JN_HEADERSIZE, journal->f) != JN_HEADERSIZE) journal->error = KN_ERROR_TRUNCATED;
+	else if ((memcmp(header, "GVJN", 4) != 0) || (Get16(header + 4) > JN_VERSION)) journal->error = KN_ERROR_FORMAT;
+	if (journal->error != 0) return(journal->error);
+	unsigned long long offset = JN_HEADERSIZE;
+	JournalRecord record;
+	while (JournalRead(journal, &offset, &record) == 0) journal->records++;
+	journal->length = offset;
+	return(0);
+}
+
+int JournalClose(LearningJournal* journal)
+{
+	int error = journal->error;
+	if (journal->f != NULL)
+	{
+		if ((JournalSync(journal) != 0) && (error == 0)) error = journal->error;
+		fclose(journal->f);
+	}
+	free(journal->filename);
+	memset(journal, 0, sizeof(LearningJournal));
+	return(error);
+}
+
+// --------------------------------------------------------------
+// Append a record, it becomes durable with its group
+// --------------------------------------------------------------
+int JournalAppend(LearningJournal* journal, const JournalRecord* record)
+{
+	if (journal->error != 0) return(journal->error);
+	unsigned char buffer[JN_RECORDSIZE + NM_NEURONSIZE + 4];
+	int length = record->type == JN_LEARN ? record->length : 0;
+	buffer[0] = (unsigned char)record->type;
+	buffer[1] = 0;
+	Put16(buffer + 2, length);
+	Put16(buffer + 4, record->category);
+	Put16(buffer + 6, record->context);
+	Put16(buffer + 8, record->minif);
+	Put16(buffer + 10, record->maxif);
+	memcpy(buffer + JN_RECORDSIZE, record->vector, length);
+	unsigned int adler = KnowledgeAdler32(1, buffer, JN_RECORDSIZE + length);
+	Put16(buffer + JN_RECORDSIZE + length, adler & 0xFFFF);
+	Put16(buffer + JN_RECORDSIZE + length + 2, adler >> 16);
+	size_t size = JN_RECORDSIZE + length + 4;
+	// after the last complete record, a read may have moved the position of the file
+	if ((journal->pending == 0) && (fseek(journal->f, (long)journal->length, SEEK_SET) != 0)) return(journal->error = KN_ERROR_WRITE);
+	if (fwrite(buffer, 1, size, journal->f) != size) return(journal->error = KN_ERROR_WRITE);
+	journal->length += size;
+	journal->records++;
+	long long now = CommClock();
+	if (journal->pending++ == 0) journal->pendingSince = now;
+	if ((journal->pending >= journal->groupRecords) || (now - journal->pendingSince >= journal->groupNs))
+		return(JournalSync(journal));
+	return(0);
+}
+
+int JournalSync(LearningJournal* journal)
+{
+	if (fflush(journal->f) != 0) return(journal->error = KN_ERROR_WRITE);
+#ifdef _WIN32
+	if (_commit(_fileno(journal->f)) != 0) return(journal->error = KN_ERROR_WRITE);
+#else
+	if (fsync(fileno(journal->f)) != 0) return(journal->error = KN_ERROR_WRITE);
+#endif
+	journal->pending = 0;
+	return(0);
+}
+
+int JournalReset(LearningJournal* journal)
+{
+	if (journal->f != NULL) fclose(journal->f);
+	journal->pending = 0;
+	journal->f = fopen(journal->filename, "w+b");
+	if (journal->f == NULL) return(journal->error = KN_ERROR_OPEN);
+	journal->error = WriteHeader(journal);
+	return(journal->error);
+}
+
+// --------------------------------------------------------------
+// Read a record, up to the end of the last complete one
+// --------------------------------------------------------------
+int JournalRead(LearningJournal* journal, unsigned long long* offset, JournalRecord* record)
+{
+	if ((journal->pending > 0) && (JournalSync(journal) != 0)) return(1);
+	unsigned char buffer[JN_RECORDSIZE + NM_NEURONSIZE + 4];
+	if ((fseek(journal->f, (long)*offset, SEEK_SET) != 0)
+		|| (fread(buffer, 1, JN_RECORDSIZE, journal->f) != JN_RECORDSIZE)) return(1);
+	int length = Get16(buffer + 2);
+	if (((buffer[0] != JN_LEARN) && (buffer[0] != JN_FORGET)) || (length > NM_NEURONSIZE)) return(1);
+	if (fread(buffer + JN_RECORDSIZE, 1, length + 4, journal->f) != (size_t)(length + 4)) return(1);
+	unsigned int adler = Get16(buffer + JN_RECORDSIZE + length) + (Get16(buffer + JN_RECORDSIZE + length + 2) << 16);
+	if (KnowledgeAdler32(1, buffer, JN_RECORDSIZE + length) != adler) return(1);
+	record->type = buffer[0];
+	record->length = length;
+	record->category = Get16(buffer + 4);
+	record->context = Get16(buffer + 6);
+	record->minif = Get16(buffer + 8);
+	record->maxif = Get16(buffer + 10);
+	memcpy(record->vector, buffer + JN_RECORDSIZE, length);
+	*offset += JN_RECORDSIZE + length + 4;
+	return(0);
+}
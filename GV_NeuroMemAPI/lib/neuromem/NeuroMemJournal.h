@@ -0,0 +1,76 @@
+// NeuroMemJournal.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Write-ahead journal of the learning operations
+//
+// While a journal is set with SetLearningJournal, Learn, LearnBatch and
+// Forget append a record to it before accessing the device. After a reset
+// of the process or of the device, RecoverLearning loads the last snapshot
+// (see NeuroMemSnapshot.h) and replays the journal with LearnBatch.
+// A snapshot saved while a journal is set empties the journal, whose
+// learnings are then part of the snapshot.
+//
+// Records are written to the file at once and made durable by groups
+// (group commit): every groupRecords records, or at the first record
+// appended groupMs after the oldest one not yet durable, or on JournalSync.
+// A reset loses at most the group in progress.
+//
+// Journal format, little-endian:
+//   header  16 bytes = "GVJN", version (uint16) = 1, 0
+//   records type (uint8), 0 (uint8), length (uint16), category (uint16),
+//           context (uint16), minif (uint16), maxif (uint16),
+//           vector (length bytes), Adler-32 of the record (uint32)
+// JN_FORGET records have no vector, maxif is the one set by Forget(Maxif)
+// or 0 for Forget(). The journal is read up to its first incomplete record.
+//
+#ifndef _NeuroMemJournal_h_
+#define _NeuroMemJournal_h_
+
+#include "stdio.h" // FILE
+#include "NeuroMemKnowledge.h" // errors KN_ERROR_xyz, Adler-32
+
+#define JN_HEADERSIZE	16
+#define JN_RECORDSIZE	12		// before the vector
+#define JN_LEARN		1
+#define JN_FORGET		2
+
+typedef struct
+{
+	int type;
+	int length;
+	int category;
+	int context;		// GCR
+	int minif;
+	int maxif;
+	unsigned char vector[NM_NEURONSIZE];
+} JournalRecord;
+
+struct LearningJournal
+{
+	FILE* f;
+	char* filename;
+	int groupRecords;
+	long long groupNs;
+	int pending;				// records not durable yet
+	long long pendingSince;
+	unsigned long long length;	// end of the last record
+	long long records;
+	int error;
+	// context of the next learnings, maintained by the NeuroMem API
+	int context, minif, maxif;
+};
+
+// open a journal and find its end, or create it if it does not exist
+int JournalOpen(LearningJournal* journal, const char* filename, int groupRecords, int groupMs);
+int JournalClose(LearningJournal* journal);
+int JournalAppend(LearningJournal* journal, const JournalRecord* record);
+// make the records appended so far durable
+int JournalSync(LearningJournal* journal);
+// remove the records, once they are saved in a snapshot
+int JournalReset(LearningJournal* journal);
+// read the record at *offset (JN_HEADERSIZE for the first one) and move
+// *offset to the next one, return 1 at the end of the journal
+int JournalRead(LearningJournal* journal, unsigned long long* offset, JournalRecord* record);
+
+#endif
@@ -0,0 +1,627 @@
+// NeuroMemKnowledge.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Codecs of the knowledge file formats described in NeuroMemKnowledge.h
+//
+#include "stdlib.h"	 //for malloc
+#include "string.h"  //for memset
+#include "GV_comm.h"
+#include "NeuroMemKnowledge.h"
+
+#define KN_IOBUFFER		(1 << 20)
+#define KN_CHUNK		256		// records per read when converting
+#define KN_MAXMATCH		130
+#define KN_MAXLITERALS	128
+
+static void Put16(unsigned char* p, unsigned int value)
+{
+	p[0] = (unsigned char)(value & 0xFF);
+	p[1] = (unsigned char)((value >> 8) & 0xFF);
+}
+
+static void Put32(unsigned char* p, unsigned int value)
+{
+	Put16(p, value & 0xFFFF);
+	Put16(p + 2, value >> 16);
+}
+
+static void Put64(unsigned char* p, unsigned long long value)
+{
+	Put32(p, (unsigned int)(value & 0xFFFFFFFF));
+	Put32(p + 4, (unsigned int)(value >> 32));
+}
+
+static unsigned int Get16(const unsigned char* p)
+{
+	return(p[0] + (p[1] << 8));
+}
+
+static unsigned int Get32(const unsigned char* p)
+{
+	return(Get16(p) + (Get16(p + 2) << 16));
+}
+
+static unsigned long long Get64(const unsigned char* p)
+{
+	return(Get32(p) + ((unsigned long long)Get32(p + 4) << 32));
+}
+
+// int of a KN_FORMAT file, 2 or 4 bytes
+static int GetInt(const unsigned char* p, int intBytes)
+{
+	if (intBytes == 2) return(Get16(p));
+	return((int)Get32(p));
+}
+
+// skip forward with seeks of a long, 32-bit on Windows
+static int Skip(FILE* f, unsigned long long bytes)
+{
+	while (bytes > 0)
+	{
+		long step = bytes > (1UL << 30) ? (1L << 30) : (long)bytes;
+		if (fseek(f, step, SEEK_CUR) != 0) return(1);
+		bytes -= step;
+	}
+	return(0);
+}
+
+// --------------------------------------------------------------
+// Adler-32 as defined in RFC 1950, start with adler = 1
+// --------------------------------------------------------------
+unsigned int KnowledgeAdler32(unsigned int adler, const unsigned char* data, size_t length)
+{
+	unsigned int a = adler & 0xFFFF, b = adler >> 16;
+	while (length > 0)
+	{
+		size_t n = length < 5552 ? length : 5552; // largest n keeping b below 2^32
+		length -= n;
+		while (n--)
+		{
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return((b << 16) | a);
+}
+
+// --------------------------------------------------------------
+// LZ compression of a block of up to 256 bytes, greedy parsing
+// with the last position of each 3-byte hash and the previous byte
+// --------------------------------------------------------------
+static int MatchLength(const unsigned char* in, int length, int from, int pos)
+{
+	int l = 0;
+	while ((pos + l < length) && (l < KN_MAXMATCH) && (in[from + l] == in[pos + l])) l++;
+	return(l);
+}
+
+static int PutLiterals(const unsigned char* in, int start, int end, unsigned char* out, int outPos)
+{
+	while (start < end)
+	{
+		int n = end - start < KN_MAXLITERALS ? end - start : KN_MAXLITERALS;
+		out[outPos++] = (unsigned char)(n - 1);
+		memcpy(out + outPos, in + start, n);
+		outPos += n;
+		start += n;
+	}
+	return(outPos);
+}
+
+int KnowledgeCompress(const unsigned char* in, int length, unsigned char* out)
+{
+	int last[256];
+	memset(last, 0xFF, sizeof(last));
+	int pos = 0, outPos = 0, literals = 0;
+	while (pos + 3 <= length)
+	{
+		int best = 0, distance = 0;
+		if (pos > 0)
+		{
+			best = MatchLength(in, length, pos - 1, pos);
+			distance = 1;
+		}
+		int hash = (in[pos] * 33 + in[pos + 1] * 7 + in[pos + 2]) & 0xFF;
+		int candidate = last[hash];
+		last[hash] = pos;
+		if ((candidate >= 0) && (pos - candidate <= 256))
+		{
+			int l = MatchLength(in, length, candidate, pos);
+			if (l > best)
+			{
+				best = l;
+				distance = pos - candidate;
+			}
+		}
+		if (best < 3)
+		{
+			pos++;
+			continue;
+		}
+		outPos = PutLiterals(in, literals, pos, out, outPos);
+		out[outPos++] = (unsigned char)(0x80 | (best - 3));
+		out[outPos++] = (unsigned char)(distance - 1);
+		pos += best;
+		literals = pos;
+	}
+	return(PutLiterals(in, literals, length, out, outPos));
+}
+
+int KnowledgeDecompress(const unsigned char* in, int inLength, unsigned char* out, int length)
+{
+	int i = 0, pos = 0;
+	while (i < inLength)
+	{
+		int token = in[i++];
+		if (token < 0x80)
+		{
+			int n = token + 1;
+			if ((i + n > inLength) || (pos + n > length)) return(1);
+			memcpy(out + pos, in + i, n);
+			i += n;
+			pos += n;
+		}
+		else
+		{
+			int n = (token & 0x7F) + 3;
+			if (i >= inLength) return(1);
+			int distance = in[i++] + 1;
+			if ((distance > pos) || (pos + n > length)) return(1);
+			for (int k = 0; k < n; k++, pos++) out[pos] = out[pos - distance];
+		}
+	}
+	return(pos == length ? 0 : 1);
+}
+
+// --------------------------------------------------------------
+// Check the header of a compact file and decode its fields
+// --------------------------------------------------------------
+int KnowledgeParseHeader(const unsigned char header[KN_HEADERSIZE], KnowledgeHeader* h)
+{
+	if (memcmp(header, "GVKN", 4) != 0) return(KN_ERROR_FORMAT);
+	if (KnowledgeAdler32(1, header, 60) != Get32(header + 60)) return(KN_ERROR_FORMAT);
+	if (Get16(header + 4) != KN_COMPACT) return(KN_ERROR_FORMAT);
+	h->flags = Get16(header + 6);
+	h->ncount = (int)Get32(header + 8);
+	h->neuronSize = Get16(header + 12);
+	h->regOffset = Get64(header + 16);
+	h->regLength = Get64(header + 24);
+	h->regChecksum = Get32(header + 32);
+	h->modelChecksum = Get32(header + 36);
+	h->modelOffset = Get64(header + 40);
+	h->modelLength = Get64(header + 48);
+	if (h->neuronSize > NM_NEURONSIZE) return(KN_ERROR_SIZE);
+	if ((h->ncount < 0) || (h->regLength != (unsigned long long)h->ncount * 8) || (h->regOffset < KN_HEADERSIZE)
+		|| (h->modelOffset < h->regOffset + h->regLength)) return(KN_ERROR_FORMAT);
+	if (((h->flags & KN_COMPRESS) == 0) && (h->modelLength != (unsigned long long)h->ncount * h->neuronSize))
+		return(KN_ERROR_FORMAT);
+	return(0);
+}
+
+// --------------------------------------------------------------
+// Open a knowledge file for reading
+// --------------------------------------------------------------
+static int OpenCompact(KnowledgeFile* kn)
+{
+	unsigned char header[KN_HEADERSIZE];
+	KnowledgeHeader h;
+	memcpy(header, "GVKN", 4);
+	if (fread(header + 4, 1, KN_HEADERSIZE - 4, kn->f) != KN_HEADERSIZE - 4) return(KN_ERROR_TRUNCATED);
+	int error = KnowledgeParseHeader(header, &h);
+	if (error) return(error);
+	kn->format = KN_COMPACT;
+	kn->flags = h.flags;
+	kn->ncount = h.ncount;
+	kn->neuronSize = h.neuronSize;
+	unsigned long long regOffset = h.regOffset;
+	unsigned long long regLength = h.regLength;
+	kn->regChecksum = h.regChecksum;
+	kn->modelChecksum = h.modelChecksum;
+	kn->modelOffset = h.modelOffset;
+	kn->modelLength = h.modelLength;
+
+	// the register section is ncount * 8 bytes, checked by KnowledgeParseHeader
+	if (kn->ncount > NM_MAXNEURONS) return(KN_ERROR_MEMORY);
+	kn->regs = (unsigned short*)malloc((size_t)regLength + 8);
+	kn->buffer = (unsigned char*)malloc(NM_NEURONSIZE + 2);
+	if ((kn->regs == NULL) || (kn->buffer == NULL)) return(KN_ERROR_MEMORY);
+	unsigned char* regBytes = (unsigned char*)kn->regs;
+	if (Skip(kn->f, regOffset - KN_HEADERSIZE) || (fread(regBytes, 1, (size_t)regLength, kn->f) != regLength))
+		return(KN_ERROR_TRUNCATED);
+	if (KnowledgeAdler32(1, regBytes, (size_t)regLength) != kn->regChecksum) return(KN_ERROR_CHECKSUM);
+	for (size_t i = 0; i < (size_t)kn->ncount * 4; i++) kn->regs[i] = (unsigned short)Get16(regBytes + (i * 2));
+	if (Skip(kn->f, kn->modelOffset - regOffset - regLength)) return(KN_ERROR_TRUNCATED);
+	return(0);
+}
+
+static int OpenFormat1704(KnowledgeFile* kn, const unsigned char* start)
+{
+	unsigned char header[16];
+	memcpy(header, start, 4);
+	// neuron size is 256: 00 01 in the second 16-bit int, 00 00 in the upper half of a 32-bit format
+	kn->intBytes = ((header[2] == 0) && (header[3] == 0)) ? 4 : 2;
+	int headerBytes = 4 * kn->intBytes;
+	if (fread(header + 4, 1, headerBytes - 4, kn->f) != (size_t)(headerBytes - 4)) return(KN_ERROR_TRUNCATED);
+	if ((GetInt(header, kn->intBytes) & 0xFFFF) < KN_FORMAT) return(KN_ERROR_FORMAT);
+	kn->format = KN_FORMAT;
+	kn->neuronSize = GetInt(header + kn->intBytes, kn->intBytes);
+	kn->ncount = GetInt(header + (2 * kn->intBytes), kn->intBytes);
+	if (kn->neuronSize > NM_NEURONSIZE) return(KN_ERROR_SIZE);
+	if ((kn->neuronSize < 0) || (kn->ncount < 0)) return(KN_ERROR_FORMAT);
+	kn->buffer = (unsigned char*)malloc((kn->neuronSize + 4) * kn->intBytes);
+	if (kn->buffer == NULL) return(KN_ERROR_MEMORY);
+	return(0);
+}
+
+int KnowledgeOpen(KnowledgeFile* kn, const char* filename)
+{
+	memset(kn, 0, sizeof(KnowledgeFile));
+	kn->adler = 1;
+	kn->f = fopen(filename, "rb");
+	if (kn->f == NULL) return(KN_ERROR_OPEN);
+	setvbuf(kn->f, NULL, _IOFBF, KN_IOBUFFER);
+	unsigned char start[4];
+	if (fread(start, 1, 4, kn->f) != 4) kn->error = KN_ERROR_TRUNCATED;
+	else if (memcmp(start, "GVKN", 4) == 0) kn->error = OpenCompact(kn);
+	else kn->error = OpenFormat1704(kn, start);
+	if (kn->error != 0)
+	{
+		int error = kn->error;
+		KnowledgeClose(kn);
+		return(error);
+	}
+	return(0);
+}
+
+// --------------------------------------------------------------
+// Open a project file for reading
+// There is no count of neurons, the records fill the end of the file
+// --------------------------------------------------------------
+static void ApplySetting(const unsigned char record[4], ProjectSettings* settings)
+{
+	int value = (record[2] << 8) + record[3];
+	if (record[0] == MOD_NM)
+	{
+		if (record[1] == NM_MINIF) settings->minif = value;
+		else if (record[1] == NM_MAXIF) settings->maxif = value;
+		return;
+	}
+	if (record[0] != MOD_CS) return;
+	switch (record[1])
+	{
+	case CS_WIDTH: settings->width = value; break;
+	case CS_HEIGHT: settings->height = value; break;
+	case CS_FEATID: settings->featID = value; break;
+	case CS_FEATNORMALIZE: settings->normalized = value; break;
+	case CS_FEATPARAM1: settings->featParam1 = value; break;
+	case CS_FEATPARAM2: settings->featParam2 = value; break;
+	case CS_FEATMINIF: settings->minif = value; break;
+	case CS_FEATMAXIF: settings->maxif = value; break;
+	default: break;
+	}
+}
+
+static int OpenProject(KnowledgeFile* kn, ProjectSettings* settings)
+{
+	unsigned char record[4];
+	int n = 0;
+	do
+	{
+		if (fread(record, 1, 4, kn->f) != 4) return(KN_ERROR_TRUNCATED);
+		if ((record[0] == 0xFF) && (record[1] == 0xFF)) break;
+		ApplySetting(record, settings);
+	} while (++n < CSP_MAXSETTINGS);
+	if (n == CSP_MAXSETTINGS) return(KN_ERROR_FORMAT);
+	long start = ftell(kn->f);
+	if ((start < 0) || (fseek(kn->f, 0, SEEK_END) != 0)) return(KN_ERROR_TRUNCATED);
+	long length = ftell(kn->f) - start;
+	// ints of 4 bytes have their upper half null, the category of a
+	// record of 2-byte ints falls in the upper half of the 130th one
+	kn->format = KN_FORMAT;
+	kn->neuronSize = NM_NEURONSIZE;
+	kn->intBytes = 4;
+	kn->buffer = (unsigned char*)malloc((NM_NEURONSIZE + 4) * 4);
+	if (kn->buffer == NULL) return(KN_ERROR_MEMORY);
+	if (fseek(kn->f, start, SEEK_SET) != 0) return(KN_ERROR_TRUNCATED);
+	if (length >= (NM_NEURONSIZE + 4) * 4)
+	{
+		if (fread(kn->buffer, (NM_NEURONSIZE + 4) * 4, 1, kn->f) != 1) return(KN_ERROR_TRUNCATED);
+		for (int i = 0; i < NM_NEURONSIZE + 4; i++)
+			if (Get16(kn->buffer + (i * 4) + 2) != 0) kn->intBytes = 2;
+		if (fseek(kn->f, start, SEEK_SET) != 0) return(KN_ERROR_TRUNCATED);
+	}
+	else kn->intBytes = 2;
+	kn->ncount = (int)(length / ((NM_NEURONSIZE + 4) * kn->intBytes));
+	return(0);
+}
+
+int KnowledgeOpenProject(KnowledgeFile* kn, const char* filename, ProjectSettings* settings)
+{
+	memset(kn, 0, sizeof(KnowledgeFile));
+	memset(settings, 0, sizeof(ProjectSettings));
+	settings->minif = DEFMINIF;
+	settings->maxif = DEFMAXIF;
+	kn->adler = 1;
+	kn->f = fopen(filename, "rb");
+	if (kn->f == NULL) return(KN_ERROR_OPEN);
+	setvbuf(kn->f, NULL, _IOFBF, KN_IOBUFFER);
+	kn->error = OpenProject(kn, settings);
+	if (kn->error != 0)
+	{
+		int error = kn->error;
+		KnowledgeClose(kn);
+		return(error);
+	}
+	return(0);
+}
+
+// --------------------------------------------------------------
+// Read the next records
+// --------------------------------------------------------------
+static int ReadCompact(KnowledgeFile* kn, NeuronRecord* neuron)
+{
+	const unsigned short* regs = kn->regs + ((size_t)kn->next * 4);
+	neuron->context = regs[0];
+	neuron->aif = regs[1];
+	neuron->minif = regs[2];
+	neuron->cat = regs[3];
+	memset(neuron->model + kn->neuronSize, 0, NM_NEURONSIZE - kn->neuronSize);
+	if ((kn->flags & KN_COMPRESS) == 0)
+	{
+		if (fread(neuron->model, 1, kn->neuronSize, kn->f) != (size_t)kn->neuronSize) return(KN_ERROR_TRUNCATED);
+		kn->adler = KnowledgeAdler32(kn->adler, neuron->model, kn->neuronSize);
+		return(0);
+	}
+	if (fread(kn->buffer, 1, 2, kn->f) != 2) return(KN_ERROR_TRUNCATED);
+	int length = Get16(kn->buffer);
+	if (length > kn->neuronSize) return(KN_ERROR_FORMAT);
+	if (fread(kn->buffer + 2, 1, length, kn->f) != (size_t)length) return(KN_ERROR_TRUNCATED);
+	kn->adler = KnowledgeAdler32(kn->adler, kn->buffer, length + 2);
+	if (length == kn->neuronSize) memcpy(neuron->model, kn->buffer + 2, length);
+	else if (KnowledgeDecompress(kn->buffer + 2, length, neuron->model, kn->neuronSize) != 0) return(KN_ERROR_FORMAT);
+	return(0);
+}
+
+static int ReadFormat1704(KnowledgeFile* kn, NeuronRecord* neuron)
+{
+	int w = kn->intBytes;
+	if (fread(kn->buffer, (kn->neuronSize + 4) * w, 1, kn->f) != 1) return(KN_ERROR_TRUNCATED);
+	const unsigned char* record = kn->buffer;
+	neuron->context = (unsigned short)GetInt(record, w);
+	for (int i = 0; i < kn->neuronSize; i++) neuron->model[i] = (unsigned char)GetInt(record + ((i + 1) * w), w);
+	memset(neuron->model + kn->neuronSize, 0, NM_NEURONSIZE - kn->neuronSize);
+	neuron->aif = (unsigned short)GetInt(record + ((kn->neuronSize + 1) * w), w);
+	neuron->minif = (unsigned short)GetInt(record + ((kn->neuronSize + 2) * w), w);
+	neuron->cat = (unsigned short)GetInt(record + ((kn->neuronSize + 3) * w), w);
+	return(0);
+}
+
+int KnowledgeRead(KnowledgeFile* kn, NeuronRecord neurons[], int count)
+{
+	int n = 0;
+	while ((n < count) && (kn->next < kn->ncount) && (kn->error == 0))
+	{
+		kn->error = kn->format == KN_COMPACT ? ReadCompact(kn, &neurons[n]) : ReadFormat1704(kn, &neurons[n]);
+		if (kn->error != 0) break;
+		kn->next++;
+		n++;
+	}
+	return(n);
+}
+
+// --------------------------------------------------------------
+// Create a knowledge file, the records follow with KnowledgeWrite
+// The compact header and register section are written on close
+// --------------------------------------------------------------
+int KnowledgeCreate(KnowledgeFile* kn, const char* filename, int format, int flags, int ncount)
+{
+	memset(kn, 0, sizeof(KnowledgeFile));
+	kn->writing = 1;
+	kn->adler = 1;
+	if ((format != KN_FORMAT) && (format != KN_COMPACT)) kn->error = KN_ERROR_FORMAT;
+	else if ((ncount < 0) || (ncount > NM_MAXNEURONS)) kn->error = KN_ERROR_MEMORY;
+	else if ((kn->f = fopen(filename, "wb")) == NULL) kn->error = KN_ERROR_OPEN;
+	if (kn->error != 0) return(kn->error);
+	setvbuf(kn->f, NULL, _IOFBF, KN_IOBUFFER);
+	kn->format = format;
+	kn->flags = format == KN_COMPACT ? flags : 0;
+	kn->ncount = ncount;
+	kn->neuronSize = NM_NEURONSIZE;
+	kn->intBytes = 4;
+	if (format == KN_FORMAT)
+	{
+		unsigned char header[16];
+		Put32(header, KN_FORMAT);
+		Put32(header + 4, NM_NEURONSIZE);
+		Put32(header + 8, ncount);
+		Put32(header + 12, 0);
+		if (fwrite(header, 1, 16, kn->f) != 16) kn->error = KN_ERROR_WRITE;
+		kn->buffer = (unsigned char*)malloc((NM_NEURONSIZE + 4) * 4);
+		if ((kn->error == 0) && (kn->buffer == NULL)) kn->error = KN_ERROR_MEMORY;
+		return(kn->error);
+	}
+	kn->regs = (unsigned short*)malloc(((size_t)ncount * 8) + 8);
+	kn->buffer = (unsigned char*)malloc(NM_NEURONSIZE + (NM_NEURONSIZE / 128) + 3);
+	if ((kn->regs == NULL) || (kn->buffer == NULL)) return(kn->error = KN_ERROR_MEMORY);
+	unsigned long long end = KN_HEADERSIZE + ((unsigned long long)ncount * 8);
+	kn->modelOffset = ((end + KN_ALIGN - 1) / KN_ALIGN) * KN_ALIGN;
+	// placeholder of the header and the registers, and padding
+	unsigned char zeros[KN_ALIGN];
+	memset(zeros, 0, KN_ALIGN);
+	for (unsigned long long pos = 0; (pos < kn->modelOffset) && (kn->error == 0); pos += KN_ALIGN)
+	{
+		size_t n = kn->modelOffset - pos < KN_ALIGN ? (size_t)(kn->modelOffset - pos) : KN_ALIGN;
+		if (fwrite(zeros, 1, n, kn->f) != n) kn->error = KN_ERROR_WRITE;
+	}
+	return(kn->error);
+}
+
+// --------------------------------------------------------------
+// Create a project file, the records follow with KnowledgeWrite
+// --------------------------------------------------------------
+int KnowledgeCreateProject(KnowledgeFile* kn, const char* filename, const ProjectSettings* settings, int ncount)
+{
+	memset(kn, 0, sizeof(KnowledgeFile));
+	kn->writing = 1;
+	kn->adler = 1;
+	kn->f = fopen(filename, "wb");
+	if (kn->f == NULL) return(kn->error = KN_ERROR_OPEN);
+	setvbuf(kn->f, NULL, _IOFBF, KN_IOBUFFER);
+	kn->format = KN_FORMAT;
+	kn->ncount = ncount;
+	kn->neuronSize = NM_NEURONSIZE;
+	kn->intBytes = 4;
+	kn->buffer = (unsigned char*)malloc((NM_NEURONSIZE + 4) * 4);
+	if (kn->buffer == NULL) return(kn->error = KN_ERROR_MEMORY);
+	const int records[9][3] = {
+		{ MOD_CS, CS_WIDTH, settings->width },
+		{ MOD_CS, CS_HEIGHT, settings->height },
+		{ MOD_CS, CS_FEATID, settings->featID },
+		{ MOD_CS, CS_FEATNORMALIZE, settings->normalized },
+		{ MOD_CS, CS_FEATPARAM1, settings->featParam1 },
+		{ MOD_CS, CS_FEATPARAM2, settings->featParam2 },
+		{ MOD_NM, NM_MINIF, settings->minif },
+		{ MOD_NM, NM_MAXIF, settings->maxif },
+		{ 0xFF, 0xFF, 0 } };	// end marker
+	unsigned char header[9 * 4];
+	for (int i = 0; i < 9; i++)
+	{
+		header[i * 4] = (unsigned char)records[i][0];
+		header[(i * 4) + 1] = (unsigned char)records[i][1];
+		header[(i * 4) + 2] = (unsigned char)((records[i][2] >> 8) & 0xFF);
+		header[(i * 4) + 3] = (unsigned char)(records[i][2] & 0xFF);
+	}
+	if (fwrite(header, 1, sizeof(header), kn->f) != sizeof(header)) kn->error = KN_ERROR_WRITE;
+	return(kn->error);
+}
+
+static int WriteCompact(KnowledgeFile* kn, const NeuronRecord* neuron)
+{
+	unsigned short* regs = kn->regs + ((size_t)kn->next * 4);
+	regs[0] = neuron->context;
+	regs[1] = neuron->aif;
+	regs[2] = neuron->minif;
+	regs[3] = neuron->cat;
+	const unsigned char* stored = neuron->model;
+	int length = kn->neuronSize;
+	if (kn->flags & KN_COMPRESS)
+	{
+		length = KnowledgeCompress(neuron->model, kn->neuronSize, kn->buffer + 2);
+		if (length >= kn->neuronSize)
+		{
+			length = kn->neuronSize;
+			memcpy(kn->buffer + 2, neuron->model, length);
+		}
+		Put16(kn->buffer, length);
+		stored = kn->buffer;
+		length += 2;
+	}
+	if (fwrite(stored, 1, length, kn->f) != (size_t)length) return(KN_ERROR_WRITE);
+	kn->adler = KnowledgeAdler32(kn->adler, stored, length);
+	kn->modelLength += length;
+	return(0);
+}
+
+static int WriteFormat1704(KnowledgeFile* kn, const NeuronRecord* neuron)
+{
+	unsigned char* record = kn->buffer;
+	Put32(record, neuron->context);
+	for (int i = 0; i < NM_NEURONSIZE; i++) Put32(record + ((i + 1) * 4), neuron->model[i]);
+	Put32(record + ((NM_NEURONSIZE + 1) * 4), neuron->aif);
+	Put32(record + ((NM_NEURONSIZE + 2) * 4), neuron->minif);
+	Put32(record + ((NM_NEURONSIZE + 3) * 4), neuron->cat);
+	if (fwrite(record, (NM_NEURONSIZE + 4) * 4, 1, kn->f) != 1) return(KN_ERROR_WRITE);
+	return(0);
+}
+
+int KnowledgeWrite(KnowledgeFile* kn, const NeuronRecord neurons[], int count)
+{
+	if (kn->next + count > kn->ncount) kn->error = KN_ERROR_WRITE;
+	for (int n = 0; (n < count) && (kn->error == 0); n++)
+	{
+		kn->error = kn->format == KN_COMPACT ? WriteCompact(kn, &neurons[n]) : WriteFormat1704(kn, &neurons[n]);
+		if (kn->error == 0) kn->next++;
+	}
+	return(kn->error);
+}
+
+static int CloseCompact(KnowledgeFile* kn)
+{
+	size_t regLength = (size_t)kn->ncount * 8;
+	unsigned char* regBytes = (unsigned char*)kn->regs;
+	for (size_t i = 0; i < (size_t)kn->ncount * 4; i++)
+	{
+		unsigned short value = kn->regs[i];
+		Put16(regBytes + (i * 2), value);
+	}
+	unsigned char header[KN_HEADERSIZE];
+	memset(header, 0, KN_HEADERSIZE);
+	memcpy(header, "GVKN", 4);
+	Put16(header + 4, KN_COMPACT);
+	Put16(header + 6, kn->flags);
+	Put32(header + 8, kn->ncount);
+	Put16(header + 12, kn->neuronSize);
+	Put64(header + 16, KN_HEADERSIZE);
+	Put64(header + 24, regLength);
+	Put32(header + 32, KnowledgeAdler32(1, regBytes, regLength));
+	Put32(header + 36, kn->adler);
+	Put64(header + 40, kn->modelOffset);
+	Put64(header + 48, kn->modelLength);
+	Put32(header + 60, KnowledgeAdler32(1, header, 60));
+	if ((fseek(kn->f, 0, SEEK_SET) != 0) || (fwrite(header, 1, KN_HEADERSIZE, kn->f) != KN_HEADERSIZE)
+		|| (fwrite(regBytes, 1, regLength, kn->f) != regLength)) return(KN_ERROR_WRITE);
+	return(0);
+}
+
+int KnowledgeClose(KnowledgeFile* kn)
+{
+	int error = kn->error;
+	if (kn->f != NULL)
+	{
+		if (kn->writing)
+		{
+			if ((error == 0) && (kn->next != kn->ncount)) error = KN_ERROR_TRUNCATED;
+			if ((error == 0) && (kn->format == KN_COMPACT)) error = CloseCompact(kn);
+			if ((fclose(kn->f) != 0) && (error == 0)) error = KN_ERROR_WRITE;
+		}
+		else
+		{
+			if ((error == 0) && (kn->format == KN_COMPACT) && (kn->next == kn->ncount) && (kn->adler != kn->modelChecksum))
+				error = KN_ERROR_CHECKSUM;
+			fclose(kn->f);
+		}
+	}
+	free(kn->buffer);
+	free(kn->regs);
+	memset(kn, 0, sizeof(KnowledgeFile));
+	return(error);
+}
+
+// --------------------------------------------------------------
+// Convert a knowledge file to another format
+// return 0 if successful or the first error of the source or destination
+// --------------------------------------------------------------
+int ConvertKnowledge(const char* source, const char* destination, int format, int flags)
+{
+	KnowledgeFile in, out;
+	int error = KnowledgeOpen(&in, source);
+	if (error != 0) return(error);
+	error = KnowledgeCreate(&out, destination, format, flags, in.ncount);
+	NeuronRecord* neurons = (NeuronRecord*)malloc(KN_CHUNK * sizeof(NeuronRecord));
+	if ((error == 0) && (neurons == NULL)) error = KN_ERROR_MEMORY;
+	while (error == 0)
+	{
+		int n = KnowledgeRead(&in, neurons, KN_CHUNK);
+		if (n == 0) break;
+		error = KnowledgeWrite(&out, neurons, n);
+	}
+	free(neurons);
+	int inError = KnowledgeClose(&in);
+	int outError = KnowledgeClose(&out);
+	if (error == 0) error = inError;
+	if (error == 0) error = outError;
+	return(error);
+}
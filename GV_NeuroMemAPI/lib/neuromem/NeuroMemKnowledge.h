@@ -0,0 +1,139 @@
+// NeuroMemKnowledge.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Reading and writing of knowledge files, independent of the device
+//
+// KN_FORMAT (0x1704), the format of the NeuroMem API and of the SD card
+// of the Arduino library, little-endian:
+//   header  int[4] = { 0x1704, neuron size, ncount, 0 }
+//   records int[neuron size + 4] = { NCR, model, AIF, MINIF, CAT }
+// The Arduino library writes the int of the board: 4 bytes, or 2 bytes
+// on the AVR boards. Both are read, the files are written with 4-byte ints.
+//
+// KN_COMPACT, version 2 of the format, little-endian:
+//   header    64 bytes
+//             0  "GVKN"
+//             4  version (uint16) = 2
+//             6  flags (uint16), KN_COMPRESS
+//             8  ncount (uint32)
+//             12 neuron size in bytes (uint16)
+//             14 reserved (uint16)
+//             16 offset of the register section (uint64)
+//             24 length of the register section (uint64)
+//             32 Adler-32 of the register section (uint32)
+//             36 Adler-32 of the model section (uint32)
+//             40 offset of the model section (uint64), multiple of KN_ALIGN
+//             48 length of the model section (uint64)
+//             56 reserved (uint32)
+//             60 Adler-32 of the bytes 0 to 59 (uint32)
+//   registers ncount * uint16[4] = { NCR, AIF, MINIF, CAT }
+//   models    ncount * neuron size bytes, or with KN_COMPRESS one block
+//             per neuron: length (uint16) and the LZ-compressed model,
+//             stored as is when the length equals the neuron size
+//
+// LZ blocks are a sequence of tokens:
+//   0x00-0x7F  literal run of token+1 bytes following the token
+//   0x80-0xFF  copy of (token & 0x7F) + 3 bytes from distance d = next byte + 1
+//              back in the block, byte by byte so d=1 repeats a byte
+// CogniSight projects (.csp), the format of the CogniSight SDK and of the
+// project files of the Arduino library:
+//   settings records of 4 bytes = { module, register, value (uint16, big-endian) }
+//            ended by the record 0xFF 0xFF 0x00 0x00
+//   records  the records of KN_FORMAT, without its header, to the end of the file
+//
+#ifndef _NeuroMemKnowledge_h_
+#define _NeuroMemKnowledge_h_
+
+#include "stdio.h" // FILE
+#include "NeuroMem.h"
+
+// KN_FORMAT, KN_COMPACT and KN_COMPRESS are defined in NeuroMem.h
+#define KN_HEADERSIZE	64
+#define KN_ALIGN		4096	// alignment of the model section
+
+// errors returned by the functions of the knowledge files
+#define KN_ERROR_OPEN		1	// file cannot be opened or created
+#define KN_ERROR_WRITE		2
+#define KN_ERROR_TRUNCATED	3
+#define KN_ERROR_FORMAT		4	// not a knowledge file, or a corrupted header
+#define KN_ERROR_SIZE		5	// neurons larger than NM_NEURONSIZE
+#define KN_ERROR_CAPACITY	6	// more neurons than the network can hold
+#define KN_ERROR_CHECKSUM	7
+#define KN_ERROR_MEMORY		8	// allocation failed
+
+// settings records of the project files
+#define MOD_CS				0x10
+#define CS_WIDTH			0x81
+#define CS_HEIGHT			0x82
+#define CS_FEATID			0x83
+#define CS_FEATNORMALIZE	0x84
+#define CS_FEATMINIF		0x85
+#define CS_FEATMAXIF		0x86
+#define CS_FEATPARAM1		0x87
+#define CS_FEATPARAM2		0x88
+#define CSP_MAXSETTINGS		100	// records read before the end marker
+
+typedef struct
+{
+	FILE* f;
+	int writing;
+	int format;				// KN_FORMAT or KN_COMPACT
+	int flags;
+	int ncount;
+	int neuronSize;
+	int intBytes;			// width of the ints of a KN_FORMAT file
+	int next;				// index of the next record
+	int error;
+	unsigned char* buffer;
+	unsigned short* regs;	// register section of a KN_COMPACT file
+	unsigned long long modelOffset;
+	unsigned long long modelLength;
+	unsigned int regChecksum;
+	unsigned int modelChecksum;
+	unsigned int adler;		// running checksum of the model section
+} KnowledgeFile;
+
+// fields of the header of a KN_COMPACT file
+typedef struct
+{
+	int flags;
+	int ncount;
+	int neuronSize;
+	unsigned long long regOffset;
+	unsigned long long regLength;
+	unsigned long long modelOffset;
+	unsigned long long modelLength;
+	unsigned int regChecksum;
+	unsigned int modelChecksum;
+} KnowledgeHeader;
+
+// check the KN_HEADERSIZE bytes at the start of a compact file, 0 if valid
+int KnowledgeParseHeader(const unsigned char header[KN_HEADERSIZE], KnowledgeHeader* h);
+// open a file of either format, the header fields are set in kn
+int KnowledgeOpen(KnowledgeFile* kn, const char* filename);
+// read up to count records, return the number read (0 at the end or on error)
+int KnowledgeRead(KnowledgeFile* kn, NeuronRecord neurons[], int count);
+// create a file of ncount neurons in a format, flags of the compact format
+int KnowledgeCreate(KnowledgeFile* kn, const char* filename, int format, int flags, int ncount);
+// append records, return 0 if successful
+int KnowledgeWrite(KnowledgeFile* kn, const NeuronRecord neurons[], int count);
+// close the file, return the first error met: a checksum mismatch of a file
+// read to the end, or fewer records written than announced at the creation
+int KnowledgeClose(KnowledgeFile* kn);
+
+// open a project file, its settings are returned in settings
+int KnowledgeOpenProject(KnowledgeFile* kn, const char* filename, ProjectSettings* settings);
+// create a project file of ncount neurons, the records follow with KnowledgeWrite
+int KnowledgeCreateProject(KnowledgeFile* kn, const char* filename, const ProjectSettings* settings, int ncount);
+
+// convert a knowledge file to a format, without a device
+int ConvertKnowledge(const char* source, const char* destination, int format, int flags);
+
+unsigned int KnowledgeAdler32(unsigned int adler, const unsigned char* data, size_t length);
+// return the length of the compressed block, at most length + length / 128 + 1
+int KnowledgeCompress(const unsigned char* in, int length, unsigned char* out);
+// return 0 if the block decodes to exactly length bytes
+int KnowledgeDecompress(const unsigned char* in, int inLength, unsigned char* out, int length);
+
+#endif
@@ -0,0 +1,176 @@
+// NeuroMemProfiler.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Per API call attribution of the comm layer statistics
+//
+#include "string.h"  //for strcmp
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "NeuroMemProfiler.h"
+
+#define PROFILER_MAXENTRIES	64
+#define PROFILER_MAXEVENTS	(1 << 20) // about 48MB of timeline
+
+typedef struct
+{
+	const char* name;
+	long long startNs;
+	long long durNs;
+	int depth;
+	int thread;
+	unsigned long long transactions;
+	unsigned long long bytes;
+	unsigned long long busNs;
+} ProfilerEvent;
+
+static std::atomic<bool> profilerOn(false);
+static std::mutex profilerLock;			// entries, events and origin
+static thread_local int profilerDepth = 0;	// scopes open in the thread
+static thread_local int profilerThread = 0;	// track of the thread in the timeline
+static std::atomic<int> profilerThreads(0);
+static long long profilerOriginNs = 0;
+static ProfilerEntry profilerEntries[PROFILER_MAXENTRIES];
+static int profilerEntryCount = 0;
+static std::vector<ProfilerEvent> profilerEvents;
+static unsigned long long profilerDroppedEvents = 0;
+
+// the scopes open when the profiler starts or stops keep their state,
+// so the depth stays balanced
+void ProfilerStart()
+{
+	std::lock_guard<std::mutex> guard(profilerLock);
+	if (profilerOriginNs == 0) profilerOriginNs = CommClock();
+	profilerOn = true;
+}
+
+void ProfilerStop()
+{
+	profilerOn = false;
+}
+
+void ProfilerReset()
+{
+	std::lock_guard<std::mutex> guard(profilerLock);
+	profilerEntryCount = 0;
+	memset(profilerEntries, 0, sizeof(profilerEntries));
+	profilerEvents.clear();
+	profilerDroppedEvents = 0;
+	profilerOriginNs = profilerOn ? CommClock() : 0;
+}
+
+// --------------------------------------------------------------
+// Entry of the report for an API function, created on first use
+// --------------------------------------------------------------
+static ProfilerEntry* ProfilerFind(const char* name)
+{
+	for (int i = 0; i < profilerEntryCount; i++)
+	{
+		// names are string literals, the pointer compare is the fast path
+		if ((profilerEntries[i].name == name) || (strcmp(profilerEntries[i].name, name) == 0))
+			return(&profilerEntries[i]);
+	}
+	if (profilerEntryCount == PROFILER_MAXENTRIES) return(NULL);
+	ProfilerEntry* entry = &profilerEntries[profilerEntryCount++];
+	entry->name = name;
+	return(entry);
+}
+
+ProfilerScope::ProfilerScope(const char* name)
+{
+	this->name = name;
+	active = profilerOn;
+	if (!active) return;
+	profilerDepth++;
+	GetCommTotals(&start);
+	startNs = CommClock();
+}
+
+ProfilerScope::~ProfilerScope()
+{
+	if (!active) return;
+	long long endNs = CommClock();
+	CommTotals end;
+	GetCommTotals(&end);
+	if (profilerDepth > 0) profilerDepth--;
+	if (profilerThread == 0) profilerThread = ++profilerThreads;
+
+	std::lock_guard<std::mutex> guard(profilerLock);
+	ProfilerEvent event;
+	event.name = name;
+	event.startNs = startNs - profilerOriginNs;
+	event.durNs = endNs - startNs;
+	event.depth = profilerDepth;
+	event.thread = profilerThread;
+	event.transactions = end.count - start.count;
+	event.bytes = end.bytes - start.bytes;
+	event.busNs = end.totalNs - start.totalNs;
+	if (profilerEvents.size() < PROFILER_MAXEVENTS) profilerEvents.push_back(event);
+	else profilerDroppedEvents++;
+
+	// only the top-level call is charged, nested calls are part of it
+	if (profilerDepth > 0) return;
+	ProfilerEntry* entry = ProfilerFind(name);
+	if (entry == NULL) return;
+	entry->calls++;
+	entry->transactions += event.transactions;
+	entry->bytes += event.bytes;
+	entry->payloadBytes += end.payloadBytes - start.payloadBytes;
+	entry->errors += end.errors - start.errors;
+	entry->busNs += event.busNs;
+	entry->wallNs += event.durNs;
+}
+
+int ProfilerGetEntries(ProfilerEntry entries[], int maxEntries)
+{
+	std::lock_guard<std::mutex> guard(profilerLock);
+	int n = profilerEntryCount < maxEntries ? profilerEntryCount : maxEntries;
+	memcpy(entries, profilerEntries, n * sizeof(ProfilerEntry));
+	return(n);
+}
+
+// --------------------------------------------------------------
+// Print the per-function table
+// efficiency is the share of the bus bytes carrying register data
+// --------------------------------------------------------------
+void ProfilerReport(FILE* out)
+{
+	std::lock_guard<std::mutex> guard(profilerLock);
+	fprintf(out, "\n%-16s %10s %12s %10s %14s %10s %12s %12s %8s",
+		"Function", "Calls", "Transactions", "Trans/call", "Bytes", "Efficiency", "Bus ms", "Wall ms", "Errors");
+	for (int i = 0; i < profilerEntryCount; i++)
+	{
+		ProfilerEntry* e = &profilerEntries[i];
+		double efficiency = e->bytes ? (100.0 * e->payloadBytes) / e->bytes : 0.0;
+		fprintf(out, "\n%-16s %10llu %12llu %10.1f %14llu %9.1f%% %12.3f %12.3f %8llu",
+			e->name, e->calls, e->transactions, e->calls ? (double)e->transactions / e->calls : 0.0,
+			e->bytes, efficiency, e->busNs / 1e6, e->wallNs / 1e6, e->errors);
+	}
+	if (profilerDroppedEvents)
+		fprintf(out, "\n%llu timeline events dropped", profilerDroppedEvents);
+	fprintf(out, "\n");
+}
+
+// --------------------------------------------------------------
+// Write the timeline as Chrome trace events (complete events "X")
+// return 0 if successful
+// --------------------------------------------------------------
+int ProfilerWriteTrace(const char* filename)
+{
+	FILE* f = fopen(filename, "w");
+	if (f == NULL) return(1);
+	std::lock_guard<std::mutex> guard(profilerLock);
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for (size_t i = 0; i < profilerEvents.size(); i++)
+	{
+		ProfilerEvent* e = &profilerEvents[i];
+		fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"NeuroMem\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+			"\"args\":{\"depth\":%d,\"transactions\":%llu,\"bytes\":%llu,\"bus_us\":%.3f}}",
+			i ? "," : "", e->name, e->thread, e->startNs / 1e3, e->durNs / 1e3, e->depth, e->transactions, e->bytes, e->busNs / 1e3);
+	}
+	fprintf(f, "\n]}\n");
+	int error = ferror(f) ? 2 : 0;
+	fclose(f);
+	return(error);
+}
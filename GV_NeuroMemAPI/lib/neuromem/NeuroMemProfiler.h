@@ -0,0 +1,61 @@
+// NeuroMemProfiler.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Attribution of the bus traffic to the NeuroMem API calls
+//
+// Each function of NeuroMem.cpp opens a profiling scope. While the
+// profiler is started, the transactions, bytes and bus time counted
+// by the comm layer (see GV_comm.h) during a top-level API call are
+// charged to that call. Nested calls (Broadcast inside Learn, ClearNeurons
+// inside WriteNeurons) appear in the timeline but are not counted twice
+// in the report.
+// The API can be profiled from several threads: the nesting of the calls
+// is followed per thread and the timeline has one track per thread. The
+// counts of the comm layer are global, so a call is also charged with the
+// traffic of the calls other threads make at the same time.
+//
+#ifndef _NeuroMemProfiler_h_
+#define _NeuroMemProfiler_h_
+
+#include "stdio.h" // FILE
+#include "GV_comm.h"
+
+void ProfilerStart();
+void ProfilerStop();
+void ProfilerReset();
+// per-function table of calls, transactions, bytes and time
+void ProfilerReport(FILE* out);
+// timeline in the Chrome trace event format, open with chrome://tracing or ui.perfetto.dev
+int ProfilerWriteTrace(const char* filename);
+
+typedef struct
+{
+	const char* name;
+	unsigned long long calls;
+	unsigned long long transactions;
+	unsigned long long bytes;
+	unsigned long long payloadBytes;
+	unsigned long long errors;
+	unsigned long long busNs;	// time spent inside the comm layer
+	unsigned long long wallNs;	// time spent inside the API call
+} ProfilerEntry;
+
+// copy up to maxEntries entries of the report, return the number of entries
+int ProfilerGetEntries(ProfilerEntry entries[], int maxEntries);
+
+class ProfilerScope
+{
+public:
+	ProfilerScope(const char* name);
+	~ProfilerScope();
+private:
+	const char* name;
+	long long startNs;
+	CommTotals start;
+	bool active;
+};
+
+#define NM_PROFILE(name) ProfilerScope profilerScope_(name)
+
+#endif
@@ -0,0 +1,343 @@
+// NeuroMemSnapshot.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Append-only log of the incremental snapshots described in NeuroMemSnapshot.h
+//
+#ifdef _WIN32
+#include <Windows.h>	// MoveFileEx
+#include <io.h>		// _commit
+#else
+#include <unistd.h>	// fsync
+#endif
+#include "stdlib.h"	 //for malloc
+#include "string.h"  //for memcpy
+#include "NeuroMemSnapshot.h"
+
+#define SN_VERSION		1
+#define SN_CHANGESIZE	8
+#define SN_NEURONSIZE	(8 + NM_NEURONSIZE)
+#define SN_CHUNK		256		// neurons per read when compacting
+
+static void Put16(unsigned char* p, unsigned int value)
+{
+	p[0] = (unsigned char)(value & 0xFF);
+	p[1] = (unsigned char)((value >> 8) & 0xFF);
+}
+
+static void Put32(unsigned char* p, unsigned int value)
+{
+	Put16(p, value & 0xFFFF);
+	Put16(p + 2, value >> 16);
+}
+
+static unsigned int Get16(const unsigned char* p)
+{
+	return(p[0] + (p[1] << 8));
+}
+
+static unsigned int Get32(const unsigned char* p)
+{
+	return(Get16(p) + (Get16(p + 2) << 16));
+}
+
+// seek to an offset of the log with seeks of a long, 32-bit on Windows
+static int SeekTo(FILE* f, unsigned long long offset)
+{
+	if (fseek(f, 0, SEEK_SET) != 0) return(1);
+	while (offset > 0)
+	{
+		long step = offset > (1UL << 30) ? (1L << 30) : (long)offset;
+		if (fseek(f, step, SEEK_CUR) != 0) return(1);
+		offset -= step;
+	}
+	return(0);
+}
+
+// flush the log and wait until the device has its data, as JournalSync
+static int SyncLog(SnapshotLog* log)
+{
+	if (fflush(log->f) != 0) return(1);
+#ifdef _WIN32
+	if (_commit(_fileno(log->f)) != 0) return(1);
+#else
+	if (fsync(fileno(log->f)) != 0) return(1);
+#endif
+	return(0);
+}
+
+static int Reserve(SnapshotLog* log, int ncount)
+{
+	if (ncount <= log->capacity) return(0);
+	int capacity = log->capacity > 0 ? log->capacity : 1024;
+	while (capacity < ncount) capacity *= 2;
+	unsigned short* regs = (unsigned short*)realloc(log->regs, (size_t)capacity * 4 * sizeof(unsigned short));
+	if (regs == NULL) return(KN_ERROR_MEMORY);
+	log->regs = regs;
+	unsigned long long* models = (unsigned long long*)realloc(log->models, (size_t)capacity * sizeof(unsigned long long));
+	if (models == NULL) return(KN_ERROR_MEMORY);
+	log->models = models;
+	log->capacity = capacity;
+	return(0);
+}
+
+// --------------------------------------------------------------
+// Read the snapshot at the end of the log
+// The payload is checked before being applied to the neurons
+// return 0 if the snapshot is complete, 2 if memory is missing
+// --------------------------------------------------------------
+static int ReplaySnapshot(SnapshotLog* log)
+{
+	unsigned char header[SN_RECORDSIZE];
+	if (fread(header, 1, SN_RECORDSIZE, log->f) != SN_RECORDSIZE) return(1);
+	int flags = (int)Get32(header);
+	unsigned int ncount = Get32(header + 4);
+	unsigned int changed = Get32(header + 8);
+	unsigned int added = Get32(header + 12);
+	unsigned int known = (flags & SN_BASE) ? 0 : (unsigned int)log->ncount;
+	if ((ncount != known + added) || ((flags & SN_BASE) && (changed != 0)) || (ncount > 0x7FFFFFFF)) return(1);
+	unsigned long long payload = ((unsigned long long)changed * SN_CHANGESIZE) + ((unsigned long long)added * SN_NEURONSIZE);
+	unsigned char buffer[4096];
+	unsigned int adler = 1;
+	for (unsigned long long pos = 0; pos < payload; pos += sizeof(buffer))
+	{
+		size_t n = payload - pos < sizeof(buffer) ? (size_t)(payload - pos) : sizeof(buffer);
+		if (fread(buffer, 1, n, log->f) != n) return(1);
+		adler = KnowledgeAdler32(adler, buffer, n);
+	}
+	if (adler != Get32(header + 16)) return(1);
+
+	// apply the snapshot
+	unsigned long long offset = log->length + SN_RECORDSIZE;
+	if (SeekTo(log->f, offset)) return(1);
+	for (unsigned int i = 0; i < changed; i++)
+	{
+		if (fread(buffer, 1, SN_CHANGESIZE, log->f) != SN_CHANGESIZE) return(1);
+		unsigned int index = Get32(buffer);
+		if (index >= known) return(1);
+		log->regs[(size_t)index * 4 + 1] = (unsigned short)Get16(buffer + 4);
+		log->regs[(size_t)index * 4 + 3] = (unsigned short)Get16(buffer + 6);
+	}
+	offset += (unsigned long long)changed * SN_CHANGESIZE;
+	if (Reserve(log, (int)ncount) != 0) return(2);
+	for (unsigned int i = known; i < ncount; i++, offset += SN_NEURONSIZE)
+	{
+		if (fread(buffer, 1, 8, log->f) != 8) return(1);
+		for (int r = 0; r < 4; r++) log->regs[(size_t)i * 4 + r] = (unsigned short)Get16(buffer + (r * 2));
+		log->models[i] = offset + 8;
+		if (fseek(log->f, NM_NEURONSIZE, SEEK_CUR) != 0) return(1);
+	}
+	log->ncount = (int)ncount;
+	log->length = offset;
+	log->snapshots = (flags & SN_BASE) ? 1 : log->snapshots + 1;
+	log->lastChanged = (int)changed;
+	log->lastAdded = (int)added;
+	return(0);
+}
+
+// --------------------------------------------------------------
+// Open a log and read its snapshots, or create an empty log
+// return 0 if successful or an error KN_ERROR_xyz
+// --------------------------------------------------------------
+int SnapshotOpen(SnapshotLog* log, const char* filename)
+{
+	memset(log, 0, sizeof(SnapshotLog));
+	log->filename = (char*)malloc(strlen(filename) + 1);
+	if (log->filename == NULL) return(log->error = KN_ERROR_MEMORY);
+	strcpy(log->filename, filename);
+	unsigned char header[SN_HEADERSIZE];
+	log->f = fopen(filename, "r+b");
+	if (log->f == NULL)
+	{
+		log->f = fopen(filename, "w+b");
+		if (log->f == NULL) return(log->error = KN_ERROR_OPEN);
+		memset(header, 0, SN_HEADERSIZE);
+		memcpy(header, "GVSN", 4);
+		Put16(header + 4, SN_VERSION);
+		Put16(header + 6, NM_NEURONSIZE);
+		if ((fwrite(header, 1, SN_HEADERSIZE, log->f) != SN_HEADERSIZE) || (fflush(log->f) != 0)) log->error = KN_ERROR_WRITE;
+		log->length = SN_HEADERSIZE;
+		return(log->error);
+	}
+	if (fread(header, 1, SN_HEADERSIZE, log->f) != SN_HEADERSIZE) log->error = KN_ERROR_TRUNCATED;
+	else if ((memcmp(header, "GVSN", 4) != 0) || (Get16(header + 4) > SN_VERSION)) log->error = KN_ERROR_FORMAT;
+	else if (Get16(header + 6) != NM_NEURONSIZE) log->error = KN_ERROR_SIZE;
+	if (log->error != 0) return(log->error);
+	log->length = SN_HEADERSIZE;
+	int result;
+	while ((result = ReplaySnapshot(log)) == 0);
+	// the next snapshot would overwrite the ones not read
+	if (result == 2) return(log->error = KN_ERROR_MEMORY);
+	return(0);
+}
+
+int SnapshotClose(SnapshotLog* log)
+{
+	int error = log->error;
+	if ((log->f != NULL) && (fclose(log->f) != 0) && (error == 0)) error = KN_ERROR_WRITE;
+	free(log->filename);
+	free(log->regs);
+	free(log->models);
+	memset(log, 0, sizeof(SnapshotLog));
+	return(error);
+}
+
+// --------------------------------------------------------------
+// Write a snapshot after the last complete one
+// The header is written last, a snapshot is only valid once ended
+// --------------------------------------------------------------
+int SnapshotBegin(SnapshotLog* log, int flags, int changed, const unsigned int index[], const unsigned short aifCat[])
+{
+	if (log->error != 0) return(log->error);
+	if (flags & SN_BASE)
+	{
+		log->ncount = 0;
+		changed = 0;
+	}
+	log->start = log->length;
+	log->flags = flags;
+	log->lastChanged = changed;
+	log->added = 0;
+	log->adler = 1;
+	unsigned char header[SN_RECORDSIZE];
+	memset(header, 0, SN_RECORDSIZE);
+	if (SeekTo(log->f, log->start) || (fwrite(header, 1, SN_RECORDSIZE, log->f) != SN_RECORDSIZE))
+		return(log->error = KN_ERROR_WRITE);
+	unsigned char entry[SN_CHANGESIZE];
+	for (int i = 0; i < changed; i++)
+	{
+		if (index[i] >= (unsigned int)log->ncount) return(log->error = KN_ERROR_FORMAT);
+		Put32(entry, index[i]);
+		Put16(entry + 4, aifCat[i * 2]);
+		Put16(entry + 6, aifCat[(i * 2) + 1]);
+		if (fwrite(entry, 1, SN_CHANGESIZE, log->f) != SN_CHANGESIZE) return(log->error = KN_ERROR_WRITE);
+		log->adler = KnowledgeAdler32(log->adler, entry, SN_CHANGESIZE);
+		log->regs[(size_t)index[i] * 4 + 1] = aifCat[i * 2];
+		log->regs[(size_t)index[i] * 4 + 3] = aifCat[(i * 2) + 1];
+	}
+	return(0);
+}
+
+int SnapshotAdd(SnapshotLog* log, const NeuronRecord neurons[], int count)
+{
+	if (log->error != 0) return(log->error);
+	if (Reserve(log, log->ncount + count) != 0) return(log->error = KN_ERROR_MEMORY);
+	unsigned long long offset = log->start + SN_RECORDSIZE + ((unsigned long long)log->lastChanged * SN_CHANGESIZE)
+		+ ((unsigned long long)log->added * SN_NEURONSIZE);
+	unsigned char regs[8];
+	for (int i = 0; i < count; i++, offset += SN_NEURONSIZE)
+	{
+		Put16(regs, neurons[i].context);
+		Put16(regs + 2, neurons[i].aif);
+		Put16(regs + 4, neurons[i].minif);
+		Put16(regs + 6, neurons[i].cat);
+		if ((fwrite(regs, 1, 8, log->f) != 8) || (fwrite(neurons[i].model, 1, NM_NEURONSIZE, log->f) != NM_NEURONSIZE))
+			return(log->error = KN_ERROR_WRITE);
+		log->adler = KnowledgeAdler32(log->adler, regs, 8);
+		log->adler = KnowledgeAdler32(log->adler, neurons[i].model, NM_NEURONSIZE);
+		unsigned short* shadow = log->regs + ((size_t)log->ncount * 4);
+		shadow[0] = neurons[i].context;
+		shadow[1] = neurons[i].aif;
+		shadow[2] = neurons[i].minif;
+		shadow[3] = neurons[i].cat;
+		log->models[log->ncount] = offset + 8;
+		log->ncount++;
+		log->added++;
+	}
+	return(0);
+}
+
+int SnapshotEnd(SnapshotLog* log)
+{
+	if (log->error != 0) return(log->error);
+	unsigned long long end = log->start + SN_RECORDSIZE + ((unsigned long long)log->lastChanged * SN_CHANGESIZE)
+		+ ((unsigned long long)log->added * SN_NEURONSIZE);
+	unsigned char header[SN_RECORDSIZE];
+	Put32(header, log->flags);
+	Put32(header + 4, log->ncount);
+	Put32(header + 8, log->lastChanged);
+	Put32(header + 12, log->added);
+	Put32(header + 16, log->adler);
+	// the payload is on the device before the header which validates it,
+	// and the header before the caller drops another copy of the learnings
+	if (SyncLog(log) || SeekTo(log->f, log->start) || (fwrite(header, 1, SN_RECORDSIZE, log->f) != SN_RECORDSIZE)
+		|| SyncLog(log)) return(log->error = KN_ERROR_WRITE);
+	log->length = end;
+	log->snapshots = (log->flags & SN_BASE) ? 1 : log->snapshots + 1;
+	log->lastAdded = log->added;
+	return(0);
+}
+
+// --------------------------------------------------------------
+// Read neurons of the last snapshot, the models are read from the
+// snapshot which added them
+// --------------------------------------------------------------
+int SnapshotRead(SnapshotLog* log, int first, NeuronRecord neurons[], int count)
+{
+	int n = 0;
+	for (int i = first; (n < count) && (i < log->ncount) && (log->error == 0); i++, n++)
+	{
+		const unsigned short* regs = log->regs + ((size_t)i * 4);
+		neurons[n].context = regs[0];
+		neurons[n].aif = regs[1];
+		neurons[n].minif = regs[2];
+		neurons[n].cat = regs[3];
+		if (SeekTo(log->f, log->models[i]) || (fread(neurons[n].model, 1, NM_NEURONSIZE, log->f) != NM_NEURONSIZE))
+			log->error = KN_ERROR_TRUNCATED;
+	}
+	return(log->error == 0 ? n : 0);
+}
+
+// --------------------------------------------------------------
+// Rewrite the log as one base snapshot of its neurons
+// The compacted log is written aside and replaces the log in one
+// step when complete, a crash leaves one of the two logs whole
+// --------------------------------------------------------------
+int SnapshotCompact(SnapshotLog* log)
+{
+	if (log->error != 0) return(log->error);
+	size_t length = strlen(log->filename);
+	char* filename = (char*)malloc(length + 5);
+	NeuronRecord* neurons = (NeuronRecord*)malloc(SN_CHUNK * sizeof(NeuronRecord));
+	if ((filename == NULL) || (neurons == NULL))
+	{
+		free(filename);
+		free(neurons);
+		return(KN_ERROR_MEMORY);
+	}
+	strcpy(filename, log->filename);
+	strcpy(filename + length, ".tmp");
+	remove(filename);
+	SnapshotLog compacted;
+	int error = SnapshotOpen(&compacted, filename);
+	if (error == 0) error = SnapshotBegin(&compacted, SN_BASE, 0, NULL, NULL);
+	for (int first = 0; (first < log->ncount) && (error == 0); first += SN_CHUNK)
+	{
+		int count = SnapshotRead(log, first, neurons, SN_CHUNK);
+		error = count > 0 ? SnapshotAdd(&compacted, neurons, count) : log->error;
+	}
+	if (error == 0) error = SnapshotEnd(&compacted);
+	int closeError = SnapshotClose(&compacted);
+	if (error == 0) error = closeError;
+	free(neurons);
+	if (error == 0)
+	{
+		fclose(log->f);
+		log->f = NULL;
+#ifdef _WIN32
+		// rename does not replace an existing file on Windows
+		if (!MoveFileExA(filename, log->filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) error = KN_ERROR_WRITE;
+#else
+		if (rename(filename, log->filename) != 0) error = KN_ERROR_WRITE;
+#endif
+		char* name = log->filename;
+		log->filename = NULL;
+		SnapshotClose(log);
+		int openError = SnapshotOpen(log, name);
+		if (error == 0) error = openError;
+		free(name);
+	}
+	if (error != 0) remove(filename);
+	free(filename);
+	return(error);
+}
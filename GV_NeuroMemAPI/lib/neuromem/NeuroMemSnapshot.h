@@ -0,0 +1,70 @@
+// NeuroMemSnapshot.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Incremental snapshots of the knowledge, saved in an append-only log
+//
+// Once committed, a neuron keeps its context, model and MINIF; learning
+// only shrinks its AIF and sets the degenerated bit of its CAT. A snapshot
+// therefore holds the AIF and CAT of the neurons which changed since the
+// previous one, found by a sweep of these two registers, and the complete
+// records of the neurons committed since then. A base snapshot holds all
+// the neurons and replaces the content of the log before it.
+//
+// Log format, little-endian:
+//   header    16 bytes = "GVSN", version (uint16) = 1, neuron size (uint16), 0 (uint64)
+//   snapshots header 20 bytes (uint32) = { flags (SN_BASE), ncount after the
+//             snapshot, changed, added, Adler-32 of the payload }
+//             changed * { index (uint32), AIF (uint16), CAT (uint16) }
+//             added * { NCR, AIF, MINIF, CAT (uint16), model (neuron size bytes) }
+// A snapshot left incomplete by a crash fails its checksum, the log is
+// read up to the last complete one and the next snapshot overwrites it.
+//
+#ifndef _NeuroMemSnapshot_h_
+#define _NeuroMemSnapshot_h_
+
+#include "stdio.h" // FILE
+#include "NeuroMemKnowledge.h" // NeuronRecord, errors KN_ERROR_xyz, Adler-32
+
+#define SN_HEADERSIZE	16
+#define SN_RECORDSIZE	20
+#define SN_BASE			0x0001	// the snapshot holds all the neurons
+
+struct SnapshotLog
+{
+	FILE* f;
+	char* filename;
+	int ncount;						// neurons after the last snapshot
+	int capacity;
+	unsigned short* regs;			// NCR, AIF, MINIF, CAT of each neuron
+	unsigned long long* models;		// offset of the model of each neuron in the log
+	unsigned long long length;		// end of the last complete snapshot
+	int snapshots;					// snapshots in the log, the first one is a base
+	int lastChanged;				// neurons changed and added by the last snapshot
+	int lastAdded;
+	// snapshot being written
+	unsigned long long start;
+	int flags;
+	int added;
+	unsigned int adler;
+	int error;
+};
+
+// open a log, or create it if it does not exist
+int SnapshotOpen(SnapshotLog* log, const char* filename);
+int SnapshotClose(SnapshotLog* log);
+
+// write a snapshot: SnapshotBegin with the changes of the known neurons,
+// SnapshotAdd for the following ones and SnapshotEnd, which makes it durable:
+// the payload then the header are flushed and synced to the device
+// a base snapshot starts again at the first neuron and has no changes
+int SnapshotBegin(SnapshotLog* log, int flags, int changed, const unsigned int index[], const unsigned short aifCat[]);
+int SnapshotAdd(SnapshotLog* log, const NeuronRecord neurons[], int count);
+int SnapshotEnd(SnapshotLog* log);
+
+// read count neurons of the last snapshot starting at first, return the number read
+int SnapshotRead(SnapshotLog* log, int first, NeuronRecord neurons[], int count);
+// rewrite the log as a single base snapshot
+int SnapshotCompact(SnapshotLog* log);
+
+#endif
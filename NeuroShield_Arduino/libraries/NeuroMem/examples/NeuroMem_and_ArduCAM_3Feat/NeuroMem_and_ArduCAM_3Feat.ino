@@ -46,6 +46,7 @@
 #include <SPI.h>
 #include <UTFT_SPI.h>
 #include "memorysaver.h"
+#include <GV_rgb565.h> // single pass feature extraction, in the NeuroMem library
 
 //*********************************************************
 //
@@ -95,6 +96,7 @@ int rgbhistoFeat[MAXVECLENGTH];
 int vlen2 = 0;
 int cprofileFeat[MAXVECLENGTH];
 int vlen3 =0;
+RGB565Features features; // sums of the three features during the readout of a frame
 int prevcat = 0, ncount = 0, catLearn = 1;
 int displaylen=6;
 #define DEF_MAXIF 0x8000
@@ -241,9 +243,14 @@ void serialEvent() {
 // Extract three feature vectors from the ROI position
 // (Left, Top) in the last frame
 // No option to normalize the feature vectors in this example
+// Return 0 if successful, 1 if the vectors do not fit in a neuron
+// and the frame is skipped
 //-----------------------------------------------------
-void getFeatureVectors(int Left, int Top) 
+int getFeatureVectors(int Left, int Top) 
 {
+  int profdiv=1; // increment if (rw + rh > 256)
+  if (RGB565Begin(&features, Left, Top, rw, rh, bw, bh, profdiv) != 0) return(1);
+
   myCAM.flush_fifo();
   myCAM.clear_fifo_flag();
   myCAM.start_capture();
@@ -254,67 +261,19 @@ void getFeatureVectors(int Left, int Top)
   
   // Read captured image as BMP565 format (320x240x 2 bytes from FIFO)
   // extract the three features on the fly
-  int hb = rw / bw, vb = rh / bh;
-  vlen= hb*vb;
-  vlen2=MAXVECLENGTH;
-  int profdiv=1; // increment if (rw + rh > 256)
-  int hb3= rw / profdiv, vb3= rh / profdiv;
-  vlen3= hb3+vb3;
-  
-  char VH, VL;
-  int indexFeat1X, indexFeat1Y, indexFeat3X, indexFeat3Y, index = 0, color;
-  uint8_t r, g, b, greylevel;
-  for (int i = 0; i < MAXVECLENGTH; i++) subsampleFeat[i] = 0; 
-  for (int i = 0; i < MAXVECLENGTH; i++) rgbhistoFeat[i] = 0; 
-  for (int i = 0; i < MAXVECLENGTH; i++) cprofileFeat[i] = 0; 
-  
   for (int y = 0 ; y < fh ; y++)
   {
     SPI.transfer(fifo_burst_line, fw*2);//read one line from spi 
-    for (int x = 0 ; x < fw ; x++)
-    {
-      VH = fifo_burst_line[x * 2];
-      VL = fifo_burst_line[(x * 2) + 1];
-      color = (VH << 8) + VL;
-
-      if ((y >= Top) && (y < Top + rh))
-      {       
-        indexFeat1Y= (y - Top) / bh;
-        indexFeat3Y = (y - Top) / profdiv;
-        if (x >= Left && x < Left + rw)
-        {             
-          r = ((color >> 11) & 0x1F);
-          g = ((color >> 6) & 0x1F);
-          b = (color & 0x001F);
-          greylevel = (r + g + b) << 1;
-
-          rgbhistoFeat[r]++;
-          rgbhistoFeat[g + 85]++;
-          rgbhistoFeat[b + 170]++;
-          
-          indexFeat1X= (x - Left) / bw;
-          indexFeat3X = (x - Left) / profdiv;
-          if ((indexFeat1X < hb) & (indexFeat1Y < vb))
-          {
-              index = (indexFeat1Y * hb) + indexFeat1X;
-              subsampleFeat[index] = subsampleFeat[index] + greylevel;
-          }
-          if ((indexFeat3X < hb3) & (indexFeat3Y < vb3))
-          {
-              cprofileFeat[indexFeat3X] = cprofileFeat[indexFeat3X] + greylevel;
-              cprofileFeat[indexFeat3Y + hb3] = cprofileFeat[indexFeat3Y + hb3] + greylevel;
-          }
-        }
-      }
-    }
+    RGB565Line(&features, fifo_burst_line, y);
   }
 
   myCAM.CS_HIGH();
     
-  for (int i = 0; i < vlen; i++) subsampleFeat[i] = subsampleFeat[i] / (bw * bh);
-  for (int i = 0; i < vlen2; i++) rgbhistoFeat[i] = rgbhistoFeat[i] * 255 / (rw * rh);
-  for (int i = 0; i < hb3; i++) cprofileFeat[i] = cprofileFeat[i] / hb3;
-  for (int i = 0; i < vb3; i++) cprofileFeat[i + hb3] = cprofileFeat[i + hb3] / vb3;
+  RGB565End(&features, subsampleFeat, rgbhistoFeat, cprofileFeat);
+  vlen = features.length[0];
+  vlen2 = features.length[1];
+  vlen3 = features.length[2];
+  return(0);
 }
 //--------------------------------------------------------
 // Recognize the feature vector  and display result on LCD
@@ -324,7 +283,7 @@ void recognize(int Left, int Top)
   int dist = 0xFFFF, cat=0xFFFF, cat1 = 0, cat2=0, cat3=0, nid = 0; 
   char tmpStr[10];
   char StrR[40] = {""};
-  getFeatureVectors(Left, Top);
+  if (getFeatureVectors(Left, Top) != 0) return;
   // recognize feature vector #1 or subsample vector
   hNN.GCR(1);
   hNN.classify(subsampleFeat, vlen, &dist, &cat1, &nid);
@@ -367,7 +326,11 @@ void learn(int Left, int Top, int Category)
   char tmpStr[10];
   char StrL[40] = {""};
   Serial.print("\n\nLearning object category "); Serial.println(Category);
-  getFeatureVectors(Left, Top);
+  if (getFeatureVectors(Left, Top) != 0)
+  {
+    Serial.println("ROI too large for the neurons");
+    return;
+  }
 
   // learn feature vector #1 or subsample vector  
   hNN.GCR(1);
@@ -37,6 +37,9 @@ NeuroMemAI hNN;
 #include <SD.h>
 File SDfile;
 
+#include <GV_window.h>
+SampleWindow window; // overlapping windows of the samples of the IMU
+
 int* vector=0;
 int prevncount=0, prevcat=0, vlen=0; // buffers for previous values
 int dist, cat, nid, nsr, ncount; // response from the neurons
@@ -53,6 +56,7 @@ int displaylen=10; // length of the data displayed on serial monitor
 
 int VAL=0;
 int sampleNbr=20; // number of samples appended into a feature vector
+int hopNbr=5; // number of new samples between two feature vectors
 int channelNbr=6; // ax,ay,az,gx,gy,gz
 int16_t ax, ay, az, gx, gy, gz;  
 
@@ -120,7 +124,7 @@ void setup()
     sampleNbr = hNN.NEURONSIZE / channelNbr;
   }
 
-  vector = new int[sampleNbr*channelNbr];
+  WindowOpen(&window, channelNbr, sampleNbr, hopNbr);
   vlen = sampleNbr*channelNbr;
   if (displaylen > vlen) displaylen = vlen;
   
@@ -281,6 +285,7 @@ void processSerialEvent()
       recoFlag=false;
       noveltyFlag=false;
       transmitFlag=false;
+      WindowReset(&window); // the next vector is made of new samples only
       if (inputString == "h\n") // ********* Help
       {
         showInstructions();
@@ -394,22 +399,22 @@ float convertRawGyro(int gRaw) {
 }
 //------------------------------------------------------
 // Assemble a feature vector from the selected channels
-// by sampling sensor data over a number of iterations
-//
+// with the last sampleNbr samples, every hopNbr samples
+// The samples are converted to 0-255 as convertRawAcceleration
+// and convertRawGyro, once when they enter the window
+// The samples are read here, in the loop, since the I2C transfers
+// of the MPU6050 cannot run in an interrupt
 //------------------------------------------------------
 int extractFeatureVector()
 {
-  millisPrevious = millis();
-  for (int j=0; j<sampleNbr; j++)
+  const int* window_vector = NULL;
+  while (window_vector == NULL)
   {
-    getSensorData();
-    vector[(j*channelNbr)]= (int)(ax);
-    vector[(j*channelNbr)+1]= (int)(ay);
-    vector[(j*channelNbr)+2]= (int)(az);
-    vector[(j*channelNbr)+3]= (int)(gx);
-    vector[(j*channelNbr)+4]= (int)(gy);
-    vector[(j*channelNbr)+5]= (int)(gz);   
+    int16_t sample[6];
+    mpu.getMotion6(&sample[0], &sample[1], &sample[2], &sample[3], &sample[4], &sample[5]);
+    window_vector = WindowAdd(&window, sample);
   }
+  vector = (int*)window_vector;
   return(sampleNbr*channelNbr);
 }
 //------------------------------------------------------
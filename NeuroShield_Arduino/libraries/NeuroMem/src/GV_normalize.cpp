@@ -0,0 +1,258 @@
+// GV_normalize.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Normalization declared in GV_normalize.h
+//
+#include "GV_normalize.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FEAT_SSE2
+#include <emmintrin.h>
+#endif
+
+#define NORM_LANES	8	// components converted at once
+
+// ranges of the components, with the two halves of their scale
+typedef struct
+{
+	int16_t low[NORM_MAXLENGTH];
+	int16_t high[NORM_MAXLENGTH];
+	uint16_t scaleH[NORM_MAXLENGTH];
+	uint16_t scaleL[NORM_MAXLENGTH];
+} Ranges;
+
+int NormalizeOpen(Normalizer* norm, int mode, int length, int channels)
+{
+	if ((mode < NORM_MINMAX) || (mode > NORM_ZSCORE) || (length < 1) || (length > NORM_MAXLENGTH) || (channels < 1) || (channels > NORM_MAXCHANNELS)) return(1);
+	norm->mode = mode;
+	norm->length = length;
+	norm->channels = channels;
+	norm->spread = 2;
+	for (int c = 0; c < channels; c++) NormalizeRange(norm, c, -32768, 32767);
+	return(0);
+}
+
+void NormalizeRange(Normalizer* norm, int channel, int low, int high)
+{
+	norm->low[channel] = (int16_t)low;
+	norm->high[channel] = (int16_t)high;
+}
+
+void NormalizeSpread(Normalizer* norm, int spread)
+{
+	norm->spread = spread < 1 ? 1 : spread;
+}
+
+void NormalizeCalibrate(Normalizer* norm, const int16_t* vectors, int count)
+{
+	int low[NORM_MAXCHANNELS], high[NORM_MAXCHANNELS];
+	for (int c = 0; c < norm->channels; c++) { low[c] = 32767; high[c] = -32768; }
+	for (int k = 0; k < count; k++)
+	{
+		const int16_t* v = vectors + ((long)k * norm->length);
+		for (int i = 0, c = 0; i < norm->length; i++)
+		{
+			if (v[i] < low[c]) low[c] = v[i];
+			if (v[i] > high[c]) high[c] = v[i];
+			if (++c == norm->channels) c = 0;
+		}
+	}
+	for (int c = 0; c < norm->channels; c++)
+	{
+		if (low[c] <= high[c]) NormalizeRange(norm, c, low[c], high[c]);
+	}
+}
+
+static void SetRange(Ranges* r, int index, int low, int high)
+{
+	if (low < -32768) low = -32768;
+	if (high > 32767) high = 32767;
+	if (high <= low)
+	{
+		if (high < 32767) high = low + 1;
+		else low = high - 1;
+	}
+	uint32_t range = (uint32_t)((int32_t)high - low);
+	uint32_t scale = (((uint32_t)255 << 24) + range - 1) / range;
+	r->low[index] = (int16_t)low;
+	r->high[index] = (int16_t)high;
+	r->scaleH[index] = (uint16_t)(scale >> 16);
+	r->scaleL[index] = (uint16_t)(scale & 0xFFFF);
+}
+
+static void SetUniform(Ranges* r, int low, int high)
+{
+	SetRange(r, 0, low, high);
+	for (int i = 1; i < NORM_LANES; i++)
+	{
+		r->low[i] = r->low[0];
+		r->high[i] = r->high[0];
+		r->scaleH[i] = r->scaleH[0];
+		r->scaleL[i] = r->scaleL[0];
+	}
+}
+
+// --------------------------------------------------------------
+// Conversion of a vector with the ranges of its components, or
+// the range 0 of all the components if step is 0
+// For d = v - low <= high - low, d * scaleH < 2^16 and the result
+// (d * scaleH * 2^16 + d * scaleL) >> 24 is the sum of the 16-bit
+// d * scaleH and the upper half of d * scaleL, shifted by 8
+// --------------------------------------------------------------
+static void Stretch(const int16_t* v, int length, const Ranges* r, int step, NormComponent* out)
+{
+	int i = 0;
+#ifdef FEAT_SSE2
+	__m128i bytes = _mm_set1_epi16(0xFF);
+	for (; i + NORM_LANES <= length; i += NORM_LANES)
+	{
+		int p = i * step;
+		__m128i x = _mm_loadu_si128((const __m128i*)(v + i));
+		__m128i low = _mm_loadu_si128((const __m128i*)(r->low + p));
+		__m128i high = _mm_loadu_si128((const __m128i*)(r->high + p));
+		__m128i d = _mm_sub_epi16(x, low);
+		__m128i a = _mm_mullo_epi16(d, _mm_loadu_si128((const __m128i*)(r->scaleH + p)));
+		__m128i b = _mm_mulhi_epu16(d, _mm_loadu_si128((const __m128i*)(r->scaleL + p)));
+		__m128i carry = _mm_srli_epi16(_mm_add_epi16(_mm_and_si128(a, bytes), _mm_and_si128(b, bytes)), 8);
+		__m128i y = _mm_add_epi16(_mm_add_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)), carry);
+		y = _mm_andnot_si128(_mm_cmplt_epi16(x, low), y);
+		y = _mm_or_si128(y, _mm_and_si128(_mm_cmpgt_epi16(x, high), bytes));
+		_mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(y, y));
+	}
+#endif
+	for (; i < length; i++)
+	{
+		int p = i * step;
+		if (v[i] < r->low[p]) out[i] = 0;
+		else if (v[i] > r->high[p]) out[i] = 255;
+		else
+		{
+			uint32_t scale = ((uint32_t)r->scaleH[p] << 16) + r->scaleL[p];
+			out[i] = (NormComponent)(((uint32_t)((int32_t)v[i] - r->low[p]) * scale) >> 24);
+		}
+	}
+}
+
+// --------------------------------------------------------------
+// Statistics of a vector
+// --------------------------------------------------------------
+static void MinMax(const int16_t* v, int length, int* min, int* max)
+{
+	int i = 0;
+	*min = 32767;
+	*max = -32768;
+#ifdef FEAT_SSE2
+	if (length >= NORM_LANES)
+	{
+		__m128i vmin = _mm_set1_epi16(32767), vmax = _mm_set1_epi16(-32768);
+		for (; i + NORM_LANES <= length; i += NORM_LANES)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i*)(v + i));
+			vmin = _mm_min_epi16(vmin, x);
+			vmax = _mm_max_epi16(vmax, x);
+		}
+		int16_t lanes[2 * NORM_LANES];
+		_mm_storeu_si128((__m128i*)lanes, vmin);
+		_mm_storeu_si128((__m128i*)(lanes + NORM_LANES), vmax);
+		for (int k = 0; k < NORM_LANES; k++)
+		{
+			if (lanes[k] < *min) *min = lanes[k];
+			if (lanes[k + NORM_LANES] > *max) *max = lanes[k + NORM_LANES];
+		}
+	}
+#endif
+	for (; i < length; i++)
+	{
+		if (v[i] < *min) *min = v[i];
+		if (v[i] > *max) *max = v[i];
+	}
+}
+
+static uint32_t SquareRoot(uint64_t x)
+{
+	uint64_t root = 0, bit = (uint64_t)1 << 62;
+	while (bit > x) bit >>= 2;
+	while (bit != 0)
+	{
+		if (x >= root + bit)
+		{
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else root >>= 1;
+		bit >>= 2;
+	}
+	return((uint32_t)root);
+}
+
+// mean - spread * deviation and mean + spread * deviation
+static void Deviation(const int16_t* v, int length, int spread, int* low, int* high)
+{
+	int64_t sum = 0;
+	uint64_t squares = 0;
+	int i = 0;
+#ifdef FEAT_SSE2
+	// the sums of 2 squares are below 2^31 + 1 and added as unsigned
+	__m128i ones = _mm_set1_epi16(1), zero = _mm_setzero_si128();
+	__m128i vsum = zero, vsquares = zero;
+	for (; i + NORM_LANES <= length; i += NORM_LANES)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(v + i));
+		vsum = _mm_add_epi32(vsum, _mm_madd_epi16(x, ones));
+		__m128i s = _mm_madd_epi16(x, x);
+		vsquares = _mm_add_epi64(vsquares, _mm_add_epi64(_mm_unpacklo_epi32(s, zero), _mm_unpackhi_epi32(s, zero)));
+	}
+	int32_t sums[4];
+	uint64_t squareSums[2];
+	_mm_storeu_si128((__m128i*)sums, vsum);
+	_mm_storeu_si128((__m128i*)squareSums, vsquares);
+	sum = (int64_t)sums[0] + sums[1] + sums[2] + sums[3];
+	squares = squareSums[0] + squareSums[1];
+#endif
+	for (; i < length; i++)
+	{
+		sum += v[i];
+		squares += (uint32_t)((int32_t)v[i] * v[i]);
+	}
+	// length * deviation = sqrt(length * squares - sum^2)
+	uint32_t deviation = SquareRoot((uint64_t)(((int64_t)length * (int64_t)squares) - (sum * sum)));
+	if (deviation == 0)
+	{
+		// constant vector, at the middle of the range
+		*low = (int)(sum / length) - 1;
+		*high = *low + 2;
+		return;
+	}
+	*low = (int)((sum - ((int64_t)spread * deviation)) / length);
+	*high = (int)((sum + ((int64_t)spread * deviation)) / length);
+}
+
+void NormalizeBlock(const Normalizer* norm, const int16_t* vectors, int count, NormComponent* components)
+{
+	Ranges ranges;
+	int length = norm->length;
+	if (norm->mode == NORM_RANGE)
+	{
+		for (int i = 0, c = 0; i < length; i++)
+		{
+			SetRange(&ranges, i, norm->low[c], norm->high[c]);
+			if (++c == norm->channels) c = 0;
+		}
+	}
+	for (int k = 0; k < count; k++)
+	{
+		const int16_t* v = vectors + ((long)k * length);
+		NormComponent* out = components + ((long)k * length);
+		if (norm->mode == NORM_RANGE)
+		{
+			Stretch(v, length, &ranges, 1, out);
+			continue;
+		}
+		int low, high;
+		if (norm->mode == NORM_MINMAX) MinMax(v, length, &low, &high);
+		else Deviation(v, length, norm->spread, &low, &high);
+		SetUniform(&ranges, low, high);
+		Stretch(v, length, &ranges, 0, out);
+	}
+}
@@ -0,0 +1,58 @@
+// GV_normalize.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Conversion of blocks of 16-bit feature vectors, such as the readings of
+// sensors, to the 8-bit components of the neurons
+//
+// Each component v of a range [low, high] becomes (v - low) * 255 / (high - low),
+// 0 below low and 255 above high. The range is:
+//   NORM_MINMAX   the minimum and maximum of the vector
+//   NORM_RANGE    fixed for each channel, set by NormalizeRange or measured
+//                 by NormalizeCalibrate, the channels being interleaved in
+//                 the vectors as the ax, ay, az, gx, gy, gz of the IMU examples
+//   NORM_ZSCORE   spread standard deviations around the mean of the vector
+// The division is a multiplication by a 32-bit scale = ceil(255 * 2^24 / (high - low))
+// and a shift by 24, exact up to ranges of 4096 and at most 1 above beyond.
+// SSE2 converts 8 components at once on the host, the same integer
+// arithmetic runs on microcontrollers without division per component.
+//
+#ifndef _GV_normalize_h_
+#define _GV_normalize_h_
+
+#include <stdint.h>
+
+#define NORM_MAXLENGTH		256		// memory of a neuron
+#define NORM_MAXCHANNELS	8
+
+#define NORM_MINMAX			0
+#define NORM_RANGE			1
+#define NORM_ZSCORE			2
+
+#ifdef ARDUINO
+typedef int NormComponent;			// as the vectors of NeuroMemAI
+#else
+typedef unsigned char NormComponent;	// as the vectors of NeuroMem.h
+#endif
+
+typedef struct
+{
+	int mode;
+	int length;
+	int channels;
+	int spread;					// standard deviations on each side of the mean
+	int16_t low[NORM_MAXCHANNELS];
+	int16_t high[NORM_MAXCHANNELS];
+} Normalizer;
+
+// vectors of length components, channels interleaved; the ranges are the
+// full 16-bit range and the spread 2 until changed, return 0 if successful
+int NormalizeOpen(Normalizer* norm, int mode, int length, int channels);
+void NormalizeRange(Normalizer* norm, int channel, int low, int high);
+void NormalizeSpread(Normalizer* norm, int spread);
+// set the range of each channel to the minimum and maximum of count vectors
+void NormalizeCalibrate(Normalizer* norm, const int16_t* vectors, int count);
+// convert count vectors stored back to back
+void NormalizeBlock(const Normalizer* norm, const int16_t* vectors, int count, NormComponent* components);
+
+#endif
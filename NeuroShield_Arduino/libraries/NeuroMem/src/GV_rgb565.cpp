@@ -0,0 +1,143 @@
+// GV_rgb565.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Single pass RGB565 feature extraction declared in GV_rgb565.h
+//
+#include "string.h"  //for memset
+#include "GV_rgb565.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FEAT_SSE2
+#include <emmintrin.h>
+#endif
+
+#define RGB_CHUNK	16	// pixels decoded at once
+
+// --------------------------------------------------------------
+// 5-bit levels and grey level of count big-endian pixels
+// SSE2 decodes 16 pixels with shifts and masks of 16-bit lanes
+// --------------------------------------------------------------
+static void Decode(const unsigned char* pixels, int count, unsigned char r[], unsigned char g[], unsigned char b[], unsigned short grey[])
+{
+	int i = 0;
+#ifdef FEAT_SSE2
+	if (count == RGB_CHUNK)
+	{
+		__m128i mask = _mm_set1_epi16(0x1F);
+		__m128i c[2], cr[2], cg[2], cb[2];
+		for (int k = 0; k < 2; k++)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(pixels + (16 * k)));
+			c[k] = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			cr[k] = _mm_srli_epi16(c[k], 11);
+			cg[k] = _mm_and_si128(_mm_srli_epi16(c[k], 6), mask);
+			cb[k] = _mm_and_si128(c[k], mask);
+			_mm_storeu_si128((__m128i*)(grey + (8 * k)), _mm_slli_epi16(_mm_add_epi16(_mm_add_epi16(cr[k], cg[k]), cb[k]), 1));
+		}
+		_mm_storeu_si128((__m128i*)r, _mm_packus_epi16(cr[0], cr[1]));
+		_mm_storeu_si128((__m128i*)g, _mm_packus_epi16(cg[0], cg[1]));
+		_mm_storeu_si128((__m128i*)b, _mm_packus_epi16(cb[0], cb[1]));
+		return;
+	}
+#endif
+	for (; i < count; i++)
+	{
+		unsigned int color = (pixels[2 * i] << 8) + pixels[(2 * i) + 1];
+		r[i] = (unsigned char)(color >> 11);
+		g[i] = (unsigned char)((color >> 6) & 0x1F);
+		b[i] = (unsigned char)(color & 0x1F);
+		grey[i] = (unsigned short)((r[i] + g[i] + b[i]) << 1);
+	}
+}
+
+int RGB565Begin(RGB565Features* f, int roiL, int roiT, int roiW, int roiH, int bW, int bH, int profDiv)
+{
+	if ((roiL < 0) || (roiT < 0) || (roiW < 1) || (roiH < 1) || (bW < 1) || (bH < 1) || (profDiv < 1)) return(1);
+	f->roiL = roiL;
+	f->roiT = roiT;
+	f->roiW = roiW;
+	f->roiH = roiH;
+	f->bW = bW;
+	f->bH = bH;
+	f->hb = roiW / bW;
+	f->vb = roiH / bH;
+	f->profDiv = profDiv;
+	f->hp = roiW / profDiv;
+	f->vp = roiH / profDiv;
+	f->length[0] = f->hb * f->vb;
+	f->length[1] = RGB_HISTOLENGTH;
+	f->length[2] = f->hp + f->vp;
+	if ((f->length[0] < 1) || (f->length[0] > RGB_MAXLENGTH) || (f->hp < 1) || (f->vp < 1) || (f->length[2] > RGB_MAXLENGTH)) return(1);
+	for (int c = 0; c < 3; c++)
+	{
+		for (int level = 0; level < 32; level++) f->bin[c][level] = (unsigned char)((c * 85) + level);
+	}
+	memset(f->subsample, 0, sizeof(f->subsample));
+	memset(f->histogram, 0, sizeof(f->histogram));
+	memset(f->profile, 0, sizeof(f->profile));
+	return(0);
+}
+
+// --------------------------------------------------------------
+// Accumulation of a line, the blocks and groups of columns are
+// followed with counters instead of a division per pixel
+// --------------------------------------------------------------
+void RGB565Line(RGB565Features* f, const unsigned char* line, int y)
+{
+	int ry = y - f->roiT;
+	if ((ry < 0) || (ry >= f->roiH)) return;
+	int blocksW = ry < f->vb * f->bH ? f->hb * f->bW : 0;	// pixels of the line in whole blocks
+	int profileW = ry < f->vp * f->profDiv ? f->hp * f->profDiv : 0;
+	uint32_t* block = f->subsample + ((ry / f->bH) * f->hb);
+	uint32_t* column = f->profile;
+	int bc = 0, pc = 0;
+	uint32_t rowSum = 0;
+	unsigned char r[RGB_CHUNK], g[RGB_CHUNK], b[RGB_CHUNK];
+	unsigned short grey[RGB_CHUNK];
+	const unsigned char* pixels = line + (2 * f->roiL);
+	for (int x = 0; x < f->roiW; x += RGB_CHUNK)
+	{
+		int count = f->roiW - x < RGB_CHUNK ? f->roiW - x : RGB_CHUNK;
+		Decode(pixels + (2 * x), count, r, g, b, grey);
+		for (int i = 0; i < count; i++)
+		{
+			f->histogram[f->bin[0][r[i]]]++;
+			f->histogram[f->bin[1][g[i]]]++;
+			f->histogram[f->bin[2][b[i]]]++;
+			if (x + i < blocksW)
+			{
+				*block += grey[i];
+				if (++bc == f->bW) { bc = 0; block++; }
+			}
+			if (x + i < profileW)
+			{
+				*column += grey[i];
+				rowSum += grey[i];
+				if (++pc == f->profDiv) { pc = 0; column++; }
+			}
+		}
+	}
+	if (profileW > 0) f->profile[f->hp + (ry / f->profDiv)] += rowSum;
+}
+
+void RGB565End(const RGB565Features* f, RGBComponent subsample[], RGBComponent histogram[], RGBComponent profile[])
+{
+	uint32_t area = (uint32_t)f->bW * f->bH;
+	for (int i = 0; i < f->length[0]; i++) subsample[i] = (RGBComponent)(f->subsample[i] / area);
+	area = (uint32_t)f->roiW * f->roiH;
+	for (int i = 0; i < f->length[1]; i++) histogram[i] = (RGBComponent)((f->histogram[i] * 255) / area);
+	area = (uint32_t)f->profDiv * f->vp * f->profDiv;
+	for (int i = 0; i < f->hp; i++) profile[i] = (RGBComponent)(f->profile[i] / area);
+	area = (uint32_t)f->profDiv * f->hp * f->profDiv;
+	for (int i = f->hp; i < f->length[2]; i++) profile[i] = (RGBComponent)(f->profile[i] / area);
+}
+
+int GetRGB565Features(RGB565Features* f, const unsigned char* frame, int stride, int roiL, int roiT, int roiW, int roiH, int bW, int bH, int profDiv,
+	RGBComponent subsample[], RGBComponent histogram[], RGBComponent profile[])
+{
+	if (RGB565Begin(f, roiL, roiT, roiW, roiH, bW, bH, profDiv) != 0) return(1);
+	for (int y = roiT; y < roiT + roiH; y++) RGB565Line(f, frame + ((size_t)y * stride), y);
+	RGB565End(f, subsample, histogram, profile);
+	return(0);
+}
@@ -0,0 +1,56 @@
+// GV_rgb565.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Three feature vectors of a ROI of an RGB565 frame, extracted in a single
+// pass over the pixels, as getFeatureVectors of the Arduino example
+// NeuroMem_and_ArduCAM_3Feat:
+//   subsample   mean grey level of each block of bW x bH pixels, row by row
+//   histogram   counts of the 5-bit red, green and blue levels, at the
+//               components 0, 85 and 170, scaled to 0-255 over the ROI
+//   profile     mean grey level of each group of profDiv columns, followed
+//               by the mean grey level of each group of profDiv rows
+// The grey level of a pixel is (r + g + b) * 2 of its 5-bit levels.
+//
+// The frame is read one line at a time in the big-endian byte order of the
+// ArduCAM FIFO, so a line can be processed as soon as it is received.
+//
+#ifndef _GV_rgb565_h_
+#define _GV_rgb565_h_
+
+#include <stdint.h>
+
+#define RGB_MAXLENGTH		256		// memory of a neuron
+#define RGB_HISTOLENGTH		256		// length of the histogram, as learned by the example
+
+#ifdef ARDUINO
+typedef int RGBComponent;			// as the vectors of NeuroMemAI
+#else
+typedef unsigned char RGBComponent;	// as the vectors of NeuroMem.h
+#endif
+
+typedef struct
+{
+	int roiL, roiT, roiW, roiH;
+	int bW, bH, hb, vb;			// blocks of the subsample
+	int profDiv, hp, vp;		// column and row groups of the profile
+	int length[3];				// of the subsample, histogram and profile
+	unsigned char bin[3][32];	// component of the histogram of each level of red, green and blue
+	uint32_t subsample[RGB_MAXLENGTH];
+	uint32_t histogram[RGB_MAXLENGTH];
+	uint32_t profile[RGB_MAXLENGTH];
+} RGB565Features;
+
+// clear the sums for a new frame, return 0 if the three vectors
+// fit in a neuron
+int RGB565Begin(RGB565Features* f, int roiL, int roiT, int roiW, int roiH, int bW, int bH, int profDiv);
+// add line y of the frame, 2 bytes per pixel from its first column
+void RGB565Line(RGB565Features* f, const unsigned char* line, int y);
+// compute the vectors, of f->length[0], [1] and [2] components
+void RGB565End(const RGB565Features* f, RGBComponent subsample[], RGBComponent histogram[], RGBComponent profile[]);
+
+// the three steps over a frame of stride bytes per line
+int GetRGB565Features(RGB565Features* f, const unsigned char* frame, int stride, int roiL, int roiT, int roiW, int roiH, int bW, int bH, int profDiv,
+	RGBComponent subsample[], RGBComponent histogram[], RGBComponent profile[]);
+
+#endif
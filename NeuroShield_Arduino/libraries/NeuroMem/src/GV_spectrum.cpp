@@ -0,0 +1,201 @@
+// GV_spectrum.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Band energies declared in GV_spectrum.h
+//
+#include "stdlib.h"	 //for malloc
+#include "string.h"  //for memset
+#include "math.h"	 //for the tables
+#include "GV_spectrum.h"
+
+#define SPEC_PI		3.14159265358979323846
+
+int SpectrumOpen(SpectrumStream* spectrum, int fftSize, int hop, int bands, int flags)
+{
+	memset(spectrum, 0, sizeof(SpectrumStream));
+	int bits = 0;
+	while ((1 << bits) < fftSize) bits++;
+	if ((fftSize < 16) || (fftSize > SPEC_MAXFFT) || ((1 << bits) != fftSize) || (hop < 1) || (bands < 1) || (bands > SPEC_MAXBANDS) || (bands > fftSize / 2)) return(1);
+	int half = fftSize / 2;
+	spectrum->hann = (int16_t*)malloc(fftSize * sizeof(int16_t));
+	spectrum->cosine = (int16_t*)malloc(half * sizeof(int16_t));
+	spectrum->sine = (int16_t*)malloc(half * sizeof(int16_t));
+	spectrum->bitReverse = (int16_t*)malloc(half * sizeof(int16_t));
+	spectrum->edges = (int16_t*)malloc((bands + 1) * sizeof(int16_t));
+	spectrum->samples = (int16_t*)malloc(2 * fftSize * sizeof(int16_t));
+	spectrum->re = (int32_t*)malloc(half * sizeof(int32_t));
+	spectrum->im = (int32_t*)malloc(half * sizeof(int32_t));
+	if ((spectrum->hann == NULL) || (spectrum->cosine == NULL) || (spectrum->sine == NULL) || (spectrum->bitReverse == NULL)
+		|| (spectrum->edges == NULL) || (spectrum->samples == NULL) || (spectrum->re == NULL) || (spectrum->im == NULL))
+	{
+		SpectrumClose(spectrum);
+		return(1);
+	}
+	spectrum->fftSize = fftSize;
+	spectrum->hop = hop;
+	spectrum->bands = bands;
+	for (int n = 0; n < fftSize; n++)
+		spectrum->hann[n] = (int16_t)floor((32767.0 * 0.5 * (1.0 - cos(2.0 * SPEC_PI * n / fftSize))) + 0.5);
+	for (int k = 0; k < half; k++)
+	{
+		spectrum->cosine[k] = (int16_t)floor((32767.0 * cos(2.0 * SPEC_PI * k / fftSize)) + 0.5);
+		spectrum->sine[k] = (int16_t)floor((32767.0 * sin(2.0 * SPEC_PI * k / fftSize)) + 0.5);
+		int r = 0;
+		for (int b = 0; b < bits - 1; b++) r |= ((k >> b) & 1) << (bits - 2 - b);
+		spectrum->bitReverse[k] = (int16_t)r;
+	}
+	// bins 1 to half, each band has one bin at least
+	spectrum->edges[0] = 1;
+	for (int b = 1; b <= bands; b++)
+	{
+		int edge;
+		if (flags & SPEC_LOGBANDS) edge = (int)floor(pow((double)(half + 1), (double)b / bands) + 0.5);
+		else edge = 1 + (int)(((int32_t)b * half) / bands);
+		if (edge < spectrum->edges[b - 1] + 1) edge = spectrum->edges[b - 1] + 1;
+		if (edge > half + 1 - (bands - b)) edge = half + 1 - (bands - b);
+		spectrum->edges[b] = (int16_t)edge;
+	}
+	SpectrumRange(spectrum, 16, 48);
+	SpectrumReset(spectrum);
+	return(0);
+}
+
+void SpectrumClose(SpectrumStream* spectrum)
+{
+	free(spectrum->hann);
+	free(spectrum->cosine);
+	free(spectrum->sine);
+	free(spectrum->bitReverse);
+	free(spectrum->edges);
+	free(spectrum->samples);
+	free(spectrum->re);
+	free(spectrum->im);
+	memset(spectrum, 0, sizeof(SpectrumStream));
+}
+
+void SpectrumRange(SpectrumStream* spectrum, int low, int high)
+{
+	if (high <= low) high = low + 1;
+	spectrum->low = low << 8;
+	spectrum->scale = ((int32_t)255 << 16) / ((int32_t)(high - low) << 8);
+}
+
+void SpectrumReset(SpectrumStream* spectrum)
+{
+	spectrum->position = 0;
+	spectrum->wait = spectrum->fftSize;
+}
+
+// --------------------------------------------------------------
+// log2 in 1/256, the fraction is the 8 bits after the leading
+// one (at most 0.09 below the exact log2), 0 for 0
+// --------------------------------------------------------------
+static int Log2(uint64_t x)
+{
+	if (x == 0) return(0);
+	int msb = 0;
+	while ((x >> msb) > 1) msb++;
+	unsigned int fraction = msb >= 8 ? (unsigned int)(x >> (msb - 8)) & 0xFF : (unsigned int)(x << (8 - msb)) & 0xFF;
+	return((msb << 8) + fraction);
+}
+
+// --------------------------------------------------------------
+// Transform of a window, the samples are scaled by 2^8 and the
+// stages by 1 / 2 each, the bins are 2 / fftSize of those of the
+// samples and fit in 25 bits
+// --------------------------------------------------------------
+static const SpecComponent* Transform(SpectrumStream* spectrum, const int16_t* samples)
+{
+	int half = spectrum->fftSize / 2;
+	int32_t* re = spectrum->re;
+	int32_t* im = spectrum->im;
+	const int16_t* cosine = spectrum->cosine;
+	const int16_t* sine = spectrum->sine;
+	for (int n = 0; n < half; n++)
+	{
+		int r = spectrum->bitReverse[n];
+		re[r] = (int32_t)(((int32_t)samples[2 * n] * spectrum->hann[2 * n]) >> 7);
+		im[r] = (int32_t)(((int32_t)samples[(2 * n) + 1] * spectrum->hann[(2 * n) + 1]) >> 7);
+	}
+	// radix-2 stages of the complex FFT of half points
+	for (int length = 2; length <= half; length <<= 1)
+	{
+		int stride = spectrum->fftSize / length;
+		for (int start = 0; start < half; start += length)
+		{
+			for (int j = 0; j < length / 2; j++)
+			{
+				int a = start + j, b = a + (length / 2);
+				int64_t c = cosine[j * stride], s = sine[j * stride];
+				int32_t tr = (int32_t)(((c * re[b]) + (s * im[b]) + 0x4000) >> 15);
+				int32_t ti = (int32_t)(((c * im[b]) - (s * re[b]) + 0x4000) >> 15);
+				re[b] = (re[a] - tr + 1) >> 1;
+				im[b] = (im[a] - ti + 1) >> 1;
+				re[a] = (re[a] + tr + 1) >> 1;
+				im[a] = (im[a] + ti + 1) >> 1;
+			}
+		}
+	}
+	// split into the bins of the real samples and sum the bands
+	for (int band = 0; band < spectrum->bands; band++)
+	{
+		uint64_t energy = 0;
+		for (int k = spectrum->edges[band]; k < spectrum->edges[band + 1]; k++)
+		{
+			int64_t xr, xi;
+			if (k == half)
+			{
+				xr = re[0] - im[0];
+				xi = 0;
+			}
+			else
+			{
+				// even = (Z[k] + conj(Z[half - k])) / 2, odd = (Z[k] - conj(Z[half - k])) / 2i
+				int m = half - k;
+				int64_t er = (re[k] + re[m]) >> 1, ei = (im[k] - im[m]) >> 1;
+				int64_t orr = (im[k] + im[m]) >> 1, oi = (re[m] - re[k]) >> 1;
+				int64_t c = cosine[k], s = sine[k];
+				xr = er + (((orr * c) + (oi * s)) >> 15);
+				xi = ei + (((oi * c) - (orr * s)) >> 15);
+			}
+			energy += (uint64_t)((xr * xr) + (xi * xi));
+		}
+		int32_t value = (int32_t)(((int64_t)(Log2(energy) - spectrum->low) * spectrum->scale) >> 16);
+		if (value < 0) value = 0;
+		else if (value > 255) value = 255;
+		spectrum->vector[band] = (SpecComponent)value;
+	}
+	return(spectrum->vector);
+}
+
+// --------------------------------------------------------------
+// Streaming, each sample is written at its slot in both halves
+// of the buffer, the last window starts at the slot of the
+// next sample
+// --------------------------------------------------------------
+const SpecComponent* SpectrumAdd(SpectrumStream* spectrum, int16_t sample)
+{
+	spectrum->samples[spectrum->position] = sample;
+	spectrum->samples[spectrum->position + spectrum->fftSize] = sample;
+	if (++spectrum->position == spectrum->fftSize) spectrum->position = 0;
+	if (--spectrum->wait > 0) return(NULL);
+	spectrum->wait = spectrum->hop;
+	return(Transform(spectrum, spectrum->samples + spectrum->position));
+}
+
+const SpecComponent* SpectrumNext(SpectrumStream* spectrum, SampleRing* ring)
+{
+	int16_t sample[WIN_MAXCHANNELS];
+	while (RingPop(ring, sample) == 0)
+	{
+		const SpecComponent* vector = SpectrumAdd(spectrum, sample[0]);
+		if (vector != NULL) return(vector);
+	}
+	return(NULL);
+}
+
+const SpecComponent* GetBandEnergies(SpectrumStream* spectrum, const int16_t samples[])
+{
+	return(Transform(spectrum, samples));
+}
@@ -0,0 +1,75 @@
+// GV_spectrum.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Band energies of the spectrum of a stream of samples, such as the
+// readings of a vibration sensor or a microphone
+//
+// Every hop samples, the last fftSize samples are weighted by a Hann
+// window and transformed by a real FFT in fixed point: a complex FFT of
+// fftSize / 2 points of the even and odd samples, with Q15 twiddles and a
+// shift by 1 at each stage against overflow, followed by the split into
+// the spectrum of the real samples. The energies of the bins 1 to
+// fftSize / 2 are summed into bands of equal or logarithmic widths, and
+// the log2 of each band is quantized to 0-255 over a range set by
+// SpectrumRange. The vectors have one component per band.
+//
+// The samples are kept twice in a buffer of two windows as the windows of
+// GV_window.h, and can be taken from a SampleRing of one channel.
+//
+#ifndef _GV_spectrum_h_
+#define _GV_spectrum_h_
+
+#include <stdint.h>
+#include "GV_window.h"	// SampleRing
+
+#define SPEC_MAXFFT		1024
+#define SPEC_MAXBANDS	256		// memory of a neuron
+#define SPEC_LOGBANDS	1		// bands of logarithmic widths
+
+#ifdef ARDUINO
+typedef int SpecComponent;			// as the vectors of NeuroMemAI
+#else
+typedef unsigned char SpecComponent;	// as the vectors of NeuroMem.h
+#endif
+
+typedef struct
+{
+	int fftSize;
+	int hop;
+	int bands;
+	int16_t* hann;				// fftSize Q15 weights
+	int16_t* cosine;			// fftSize / 2 Q15 twiddles
+	int16_t* sine;
+	int16_t* bitReverse;		// fftSize / 2 indices
+	int16_t* edges;				// first bin of each band, and the end of the last one
+	int16_t* samples;			// 2 * fftSize samples
+	int32_t* re;				// fftSize / 2 points of the complex FFT
+	int32_t* im;
+	int position;				// slot of the next sample
+	int wait;					// samples before the next window
+	int low;					// log2 quantized to 0, in 1/256
+	int32_t scale;				// 255 * 2^16 / range of the log2 in 1/256
+	SpecComponent vector[SPEC_MAXBANDS];
+} SpectrumStream;
+
+// fftSize is a power of 2 from 16 to SPEC_MAXFFT and bands at most fftSize / 2;
+// the log2 of the energies from 16 to 48 are quantized until SpectrumRange
+// changes them, return 0 if successful
+// A bin of a sine of amplitude A has a log2 near 2 * log2(A) + 14, and the
+// rounding of the transform leaves energies below 2^16 inexact
+int SpectrumOpen(SpectrumStream* spectrum, int fftSize, int hop, int bands, int flags);
+void SpectrumClose(SpectrumStream* spectrum);
+// quantize the log2 of the energies from low to high to 0-255
+void SpectrumRange(SpectrumStream* spectrum, int low, int high);
+void SpectrumReset(SpectrumStream* spectrum);
+
+// add a sample, return the vector of the last window if a window is
+// complete, NULL otherwise; the vector is valid until the next window
+const SpecComponent* SpectrumAdd(SpectrumStream* spectrum, int16_t sample);
+// add the samples of the ring up to the next complete window
+const SpecComponent* SpectrumNext(SpectrumStream* spectrum, SampleRing* ring);
+// vector of a single window of fftSize samples
+const SpecComponent* GetBandEnergies(SpectrumStream* spectrum, const int16_t samples[]);
+
+#endif
@@ -0,0 +1,133 @@
+// GV_window.cpp
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Streaming windows declared in GV_window.h
+//
+#include "stdlib.h"	 //for malloc
+#include "string.h"  //for memcpy
+#include "GV_window.h"
+
+// --------------------------------------------------------------
+// Ring of samples, single producer and single consumer
+// The indices run modulo twice the capacity, so that a full ring
+// is told apart from an empty one
+// --------------------------------------------------------------
+int RingOpen(SampleRing* ring, int capacity, int channels)
+{
+	ring->samples = NULL;
+	ring->mask = 0;
+	RING_STORE(ring->head, 0);
+	RING_STORE(ring->tail, 0);
+	ring->dropped = 0;
+	if ((capacity < 1) || (capacity > WIN_MAXRING) || (channels < 1) || (channels > WIN_MAXCHANNELS)) return(1);
+	unsigned int size = 1;
+	while (size < (unsigned int)capacity) size <<= 1;
+	ring->samples = (int16_t*)malloc(size * channels * sizeof(int16_t));
+	if (ring->samples == NULL) return(1);
+	ring->channels = channels;
+	ring->mask = size - 1;
+	return(0);
+}
+
+void RingClose(SampleRing* ring)
+{
+	free(ring->samples);
+	ring->samples = NULL;
+}
+
+int RingPush(SampleRing* ring, const int16_t sample[])
+{
+	unsigned int wrap = (2 * ring->mask) + 1;
+	unsigned int head = RING_LOAD(ring->head);
+	if (((head - RING_LOAD(ring->tail)) & wrap) > ring->mask)
+	{
+		ring->dropped++;
+		return(1);
+	}
+	memcpy(ring->samples + ((head & ring->mask) * ring->channels), sample, ring->channels * sizeof(int16_t));
+	RING_STORE(ring->head, (head + 1) & wrap);
+	return(0);
+}
+
+int RingPop(SampleRing* ring, int16_t sample[])
+{
+	unsigned int wrap = (2 * ring->mask) + 1;
+	unsigned int tail = RING_LOAD(ring->tail);
+	if (tail == RING_LOAD(ring->head)) return(1);
+	memcpy(sample, ring->samples + ((tail & ring->mask) * ring->channels), ring->channels * sizeof(int16_t));
+	RING_STORE(ring->tail, (tail + 1) & wrap);
+	return(0);
+}
+
+int RingCount(SampleRing* ring)
+{
+	return((RING_LOAD(ring->head) - RING_LOAD(ring->tail)) & ((2 * ring->mask) + 1));
+}
+
+// --------------------------------------------------------------
+// Windows, each sample is written at its slot in both halves
+// of the buffer, the last window starts at the slot of the
+// next sample
+// --------------------------------------------------------------
+int WindowOpen(SampleWindow* window, int channels, int length, int hop)
+{
+	memset(window, 0, sizeof(SampleWindow));
+	if ((channels < 1) || (channels > WIN_MAXCHANNELS) || (length < 1) || (length * channels > WIN_MAXLENGTH) || (hop < 1)) return(1);
+	window->buffer = (WinComponent*)malloc(2 * length * channels * sizeof(WinComponent));
+	if (window->buffer == NULL) return(1);
+	window->channels = channels;
+	window->length = length;
+	window->hop = hop;
+	for (int c = 0; c < channels; c++) WindowScale(window, c, 508, 128);	// 127 / 16384 = 508 / 65536
+	WindowReset(window);
+	return(0);
+}
+
+void WindowClose(SampleWindow* window)
+{
+	free(window->buffer);
+	window->buffer = NULL;
+}
+
+void WindowScale(SampleWindow* window, int channel, int32_t gain, int offset)
+{
+	window->gain[channel] = gain;
+	window->offset[channel] = offset;
+}
+
+void WindowReset(SampleWindow* window)
+{
+	window->position = 0;
+	window->wait = window->length;
+}
+
+const WinComponent* WindowAdd(SampleWindow* window, const int16_t sample[])
+{
+	int channels = window->channels;
+	WinComponent* first = window->buffer + (window->position * channels);
+	WinComponent* second = first + (window->length * channels);
+	for (int c = 0; c < channels; c++)
+	{
+		int32_t value = (int32_t)(((int64_t)sample[c] * window->gain[c]) >> 16) + window->offset[c];
+		if (value < 0) value = 0;
+		else if (value > 255) value = 255;
+		first[c] = (WinComponent)value;
+		second[c] = (WinComponent)value;
+	}
+	if (++window->position == window->length) window->position = 0;
+	if (--window->wait > 0) return(NULL);
+	window->wait = window->hop;
+	return(window->buffer + (window->position * channels));
+}
+
+const WinComponent* WindowNext(SampleWindow* window, SampleRing* ring)
+{
+	int16_t sample[WIN_MAXCHANNELS];
+	while (RingPop(ring, sample) == 0)
+	{
+		const WinComponent* vector = WindowAdd(window, sample);
+		if (vector != NULL) return(vector);
+	}
+	return(NULL);
+}
@@ -0,0 +1,96 @@
+// GV_window.h
+// Copyright 2019 General Vision Inc.
+//----------------------------------------------------------------
+//
+// Overlapping windows of a stream of multichannel samples, such as the
+// ax, ay, az, gx, gy, gz readings of an IMU
+//
+// The samples are queued in a ring by a producer (a sensor thread, or an
+// interrupt on a microcontroller) and taken by a single consumer, without
+// lock. The consumer converts each sample once to 8-bit components, with
+// the gain and offset of its channel, and writes it twice in a buffer of
+// two windows. The last window is then always contiguous in the buffer, so
+// a vector of length samples is ready every hop samples for the cost of
+// these hop samples, instead of length new samples per vector.
+//
+#ifndef _GV_window_h_
+#define _GV_window_h_
+
+#include <stdint.h>
+
+#define WIN_MAXCHANNELS		8
+#define WIN_MAXLENGTH		256		// memory of a neuron
+
+#ifdef ARDUINO
+typedef int WinComponent;			// as the vectors of NeuroMemAI
+#else
+typedef unsigned char WinComponent;	// as the vectors of NeuroMem.h
+#endif
+
+// indices of the ring, written by one side and read by the other
+#if defined(__AVR__)
+// 8-bit indices are read and written atomically, up to 128 samples
+#define WIN_MAXRING			128
+typedef volatile uint8_t RingIndex;
+#define RING_LOAD(index) (index)
+#define RING_STORE(index, value) ((index) = (uint8_t)(value))
+#elif defined(ARDUINO)
+#define WIN_MAXRING			0x8000
+typedef volatile uint32_t RingIndex;
+#define RING_LOAD(index) (index)
+#define RING_STORE(index, value) ((index) = (value))
+#else
+#include <atomic>
+#define WIN_MAXRING			0x8000
+typedef std::atomic<uint32_t> RingIndex;
+#define RING_LOAD(index) (index).load(std::memory_order_acquire)
+#define RING_STORE(index, value) (index).store((value), std::memory_order_release)
+#endif
+
+struct SampleRing
+{
+	int16_t* samples;
+	int channels;
+	unsigned int mask;			// capacity - 1
+	RingIndex head;				// samples pushed, modulo the range of the index
+	RingIndex tail;				// samples popped
+	unsigned int dropped;		// samples lost while the ring was full, counted by the producer
+};
+
+// capacity is rounded up to a power of 2, return 0 if successful
+int RingOpen(SampleRing* ring, int capacity, int channels);
+void RingClose(SampleRing* ring);
+// producer side, return 1 if the ring is full and the sample is dropped
+int RingPush(SampleRing* ring, const int16_t sample[]);
+// consumer side, return 1 if the ring is empty
+int RingPop(SampleRing* ring, int16_t sample[]);
+int RingCount(SampleRing* ring);
+
+struct SampleWindow
+{
+	int channels;
+	int length;					// samples of a window
+	int hop;					// samples between two windows
+	int32_t gain[WIN_MAXCHANNELS];	// component = ((sample * gain) >> 16) + offset, clipped to 0-255
+	int offset[WIN_MAXCHANNELS];
+	WinComponent* buffer;		// 2 * length samples
+	int position;				// slot of the next sample
+	int wait;					// samples before the next window
+};
+
+// windows of length samples every hop samples, the components are the
+// samples converted as the IMU examples, ((raw * 127) / 16384) + 128,
+// until WindowScale changes a channel; return 0 if successful
+int WindowOpen(SampleWindow* window, int channels, int length, int hop);
+void WindowClose(SampleWindow* window);
+void WindowScale(SampleWindow* window, int channel, int32_t gain, int offset);
+// clear the window, for example after a pause of the sensor
+void WindowReset(SampleWindow* window);
+// add a sample, return the vector of length * channels components of the
+// last window if a window is complete, NULL otherwise; the vector is valid
+// until the next sample
+const WinComponent* WindowAdd(SampleWindow* window, const int16_t sample[]);
+// add the samples of the ring up to the next complete window
+const WinComponent* WindowNext(SampleWindow* window, SampleRing* ring);
+
+#endif
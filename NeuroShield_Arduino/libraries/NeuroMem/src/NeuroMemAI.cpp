@@ -137,13 +137,17 @@ int NeuroMemAI::countNeuronsAvailable()
 	spi.write(MOD_NM, NM_NSR, 0x0010);
 	spi.write(MOD_NM, NM_TESTCAT, 0x0001);
 	spi.write(MOD_NM, NM_RESETCHAIN, 0);
-	int read_cat=0xFFFF;	
+	// each read of CAT moves to the next neuron of the chain,
+	// so the CATs are read by bursts until one returns 0xFFFF
+	int cats[CAT_BURST];
 	navail = 0;
 	while (1) {
-		read_cat = spi.read(MOD_NM, NM_CAT);
-		if (read_cat == 0xFFFF)
+		spi.readAddr(0x01000000 + NM_CAT, CAT_BURST, cats);
+		int i = 0;
+		while ((i < CAT_BURST) && (cats[i] != 0xFFFF)) i++;
+		navail += i;
+		if (i < CAT_BURST)
 			break;
-		navail++;
 	}
 	spi.write(MOD_NM, NM_NSR, 0x0000);
 	spi.write(MOD_NM, NM_FORGET, 0);
@@ -538,9 +542,167 @@ int NeuroMemAI::saveKnowledge_SDcard(char* filename)
     SDfile.close();
 	return(0); 
 }
+// --------------------------------------------------------
+// Compact knowledge file "GVKN", version 2
+// see GV_NeuroMemAPI/lib/neuromem/NeuroMemKnowledge.h for the format
+// The register and model sections are read with two file handles,
+// the models are decompressed as they are read in a 256-byte buffer
+// --------------------------------------------------------
+typedef struct
+{
+	uint32_t a;
+	uint32_t b;
+} Adler32;
+
+static void adlerByte(Adler32* adler, byte value)
+{
+	adler->a += value;
+	if (adler->a >= 65521) adler->a -= 65521;
+	adler->b += adler->a;
+	if (adler->b >= 65521) adler->b -= 65521;
+}
+
+static uint32_t adlerValue(Adler32* adler)
+{
+	return((adler->b << 16) | adler->a);
+}
+
+static uint32_t get32(const byte* p)
+{
+	return((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+// next byte of a section, added to its checksum, -1 at the end of the file
+static int readByte(File& file, Adler32* adler)
+{
+	int value = file.read();
+	if (value >= 0) adlerByte(adler, (byte)value);
+	return(value);
+}
+
+// LZ block of length bytes decoded into model[neuronSize], 0 if successful
+static int readModel(File& file, Adler32* adler, int length, byte model[], int neuronSize)
+{
+	int i = 0, pos = 0;
+	while (i < length)
+	{
+		int token = readByte(file, adler);
+		i++;
+		if (token < 0) return(3);
+		if (token < 0x80)
+		{
+			int n = token + 1;
+			if ((i + n > length) || (pos + n > neuronSize)) return(4);
+			for (int k = 0; k < n; k++)
+			{
+				int value = readByte(file, adler);
+				if (value < 0) return(3);
+				model[pos++] = (byte)value;
+			}
+			i += n;
+		}
+		else
+		{
+			int n = (token & 0x7F) + 3;
+			int distance = readByte(file, adler) + 1;
+			i++;
+			if ((distance <= 0) || (distance > pos) || (pos + n > neuronSize)) return(4);
+			for (int k = 0; k < n; k++, pos++) model[pos] = model[pos - distance];
+		}
+	}
+	return(pos == neuronSize ? 0 : 4);
+}
+
+typedef struct
+{
+	int flags;
+	uint32_t ncount;
+	int neuronSize;
+	uint32_t regOffset; // files of the SD card are below 4GB
+	uint32_t regChecksum;
+	uint32_t modelChecksum;
+	uint32_t modelOffset;
+} CompactHeader;
+
+// header following the "GVKN" already read, 0 if successful
+static int readCompactHeader(File& file, CompactHeader* kn)
+{
+	byte header[64];
+	header[0] = 'G'; header[1] = 'V'; header[2] = 'K'; header[3] = 'N';
+	if (file.read(header + 4, 60) != 60) return(3);
+	Adler32 adler = { 1, 0 };
+	for (int i = 0; i < 60; i++) adlerByte(&adler, header[i]);
+	if (adlerValue(&adler) != get32(header + 60)) return(4);
+	if ((header[4] + (header[5] << 8)) != NeuroMemAI::KN_COMPACT) return(4);
+	kn->flags = header[6] + (header[7] << 8);
+	kn->ncount = get32(header + 8);
+	kn->neuronSize = header[12] + (header[13] << 8);
+	kn->regOffset = get32(header + 16);
+	kn->regChecksum = get32(header + 32);
+	kn->modelChecksum = get32(header + 36);
+	kn->modelOffset = get32(header + 40);
+	if (kn->neuronSize > NeuroMemAI::NEURONSIZE) return(5);
+	return(0);
+}
+
+// neurons of the file written at the current position of the chain
+static int loadCompactNeurons(File& regFile, char* filename, const CompactHeader* kn)
+{
+	int neuronSize = kn->neuronSize;
+	File modelFile = SD.open(filename, FILE_READ);
+	if (!modelFile) return(3);
+	if (!regFile.seek(kn->regOffset) || !modelFile.seek(kn->modelOffset))
+	{
+		modelFile.close();
+		return(3);
+	}
+	byte model[NeuroMemAI::NEURONSIZE];
+	Adler32 regAdler = { 1, 0 };
+	Adler32 modelAdler = { 1, 0 };
+	int error = 0;
+	for (uint32_t n = 0; (n < kn->ncount) && (error == 0); n++)
+	{
+		byte regs[8];
+		if (regFile.read(regs, 8) != 8)
+		{
+			error = 3;
+			break;
+		}
+		for (int i = 0; i < 8; i++) adlerByte(&regAdler, regs[i]);
+		int length = neuronSize;
+		if (kn->flags & NeuroMemAI::KN_COMPRESS)
+		{
+			int low = readByte(modelFile, &modelAdler);
+			int high = readByte(modelFile, &modelAdler);
+			if (high < 0)
+			{
+				error = 3;
+				break;
+			}
+			length = low + (high << 8);
+		}
+		if (length == neuronSize)
+		{
+			if (modelFile.read(model, neuronSize) != neuronSize) error = 3;
+			else for (int i = 0; i < neuronSize; i++) adlerByte(&modelAdler, model[i]);
+		}
+		else error = readModel(modelFile, &modelAdler, length, model, neuronSize);
+		if (error != 0) break;
+		spi.write(MOD_NM, NM_NCR, regs[0] + (regs[1] << 8));
+		spi.writeAddrBytes(0x01000001, neuronSize, model);
+		spi.write(MOD_NM, NM_AIF, regs[2] + (regs[3] << 8));
+		spi.write(MOD_NM, NM_MINIF, regs[4] + (regs[5] << 8));
+		spi.write(MOD_NM, NM_CAT, regs[6] + (regs[7] << 8));
+	}
+	modelFile.close();
+	if ((error == 0) && ((adlerValue(&regAdler) != kn->regChecksum) || (adlerValue(&modelAdler) != kn->modelChecksum))) error = 7;
+	return(error);
+}
+
 // --------------------------------------------------------
 // Load the neurons with a knowledge stored in a knowledge file
-// saved in a format compatible with the NeuroMem API
+// saved in a format compatible with the NeuroMem API,
+// KN_FORMAT or the compact format (error 7 if its checksums differ)
 // --------------------------------------------------------
 int NeuroMemAI::loadKnowledge_SDcard(char* filename)
 {
@@ -552,6 +714,28 @@ int NeuroMemAI::loadKnowledge_SDcard(char* filename)
 	if (!SD.exists(filename)) return(2); 
     File SDfile = SD.open(filename, FILE_READ);
     if (!SDfile) return(3);
+
+	byte magic[4];
+	if ((SDfile.read(magic, 4) == 4) && (magic[0] == 'G') && (magic[1] == 'V') && (magic[2] == 'K') && (magic[3] == 'N'))
+	{
+		CompactHeader kn;
+		int error = readCompactHeader(SDfile, &kn);
+		if ((error == 0) && (kn.ncount > (uint32_t)navail)) error = 6;
+		if (error == 0)
+		{
+			int TempGCR=spi.read(MOD_NM, NM_GCR);
+			int TempNSR=spi.read(MOD_NM, NM_NSR); // save value to restore NN upon exit
+			clearNeurons();
+			spi.write(MOD_NM, NM_NSR, 0x0010);
+			spi.write(MOD_NM, NM_RESETCHAIN, 0);
+			error = loadCompactNeurons(SDfile, filename, &kn);
+			spi.write(MOD_NM, NM_NSR, TempNSR); // set the NN back to its calling status
+			spi.write(MOD_NM, NM_GCR, TempGCR);
+		}
+		SDfile.close();
+		return(error);
+	}
+	SDfile.seek(0);
 	
     int header[4];
     int* p_myheader = header;
@@ -733,9 +917,9 @@ int NeuroMemAI::loadProject_SDcard(char* filename, int* roiWidth, int* roiHeight
 				}
 			}
 		}
-		iter++;
+		iter--;
 	} while ((Temp != 0xFFFF) & (iter>0));
-  	if (iter==0) return(4);
+  	if (Temp != 0xFFFF) return(4); // no end marker within the 100 records
 	
     int neuron[NEURONSIZE + 4];
     int* p_myneuron = neuron;
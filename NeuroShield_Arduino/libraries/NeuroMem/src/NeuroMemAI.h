@@ -19,6 +19,9 @@ class NeuroMemAI
 				
 		static const int NEURONSIZE=256; //memory capacity of each neuron in byte		
 		static const int KN_FORMAT=0x1704; // version number for the save neuron file format
+		static const int KN_COMPACT=2; // version of the compact knowledge file "GVKN", read by loadKnowledge_SDcard
+		static const int KN_COMPRESS=0x0001; // flag of the compact file, compressed models
+		static const int CAT_BURST=64; // CAT registers read per SPI burst when counting the neurons
 		int navail=0; // initialized during the begin function
 		
 		NeuroMemAI();
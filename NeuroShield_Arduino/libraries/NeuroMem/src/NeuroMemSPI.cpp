@@ -171,7 +171,31 @@ void NeuroMemSPI::writeAddr(long addr, int length, int data[])
 	}
 	digitalWrite(SPI_NMSelect, HIGH);
 	SPI.endTransaction();
-} 
+}
+// ---------------------------------------------------------
+// SPI Write_Addr command of 8-bit data, sent as words [0, data[i]]
+// length is expressed in words
+// ---------------------------------------------------------
+void NeuroMemSPI::writeAddrBytes(long addr, int length, const byte data[])
+{
+	SPI.beginTransaction(SPISettings(SPIspeed, MSBFIRST, SPI_MODE0));
+	digitalWrite(SPI_NMSelect, LOW);
+	SPI.transfer(1);  // Dummy for ID
+	SPI.transfer((byte)(((addr & 0xFF000000) >> 24) + 0x80)); // Addr3 and write flag
+	SPI.transfer((byte)((addr & 0x00FF0000) >> 16)); // Addr2
+	SPI.transfer((byte)((addr & 0x0000FF00) >> 8)); // Addr1
+	SPI.transfer((byte)(addr & 0x000000FF)); // Addr0
+	SPI.transfer((byte)((length & 0x00FF0000) >> 16)); // Length2
+	SPI.transfer((byte)((length & 0x0000FF00) >> 8)); // Length1
+	SPI.transfer((byte)(length & 0x000000FF)); // Length 0
+	for (int i = 0; i < length; i++)
+	{
+		SPI.transfer(0);
+		SPI.transfer(data[i]);
+	}
+	digitalWrite(SPI_NMSelect, HIGH);
+	SPI.endTransaction();
+}
 //---------------------------------------------
 // SPI Read_Addr command
 // multiple read of data in word format
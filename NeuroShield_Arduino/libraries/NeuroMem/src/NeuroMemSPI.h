@@ -52,6 +52,7 @@ class NeuroMemSPI
 		void write(unsigned char mod, unsigned char reg, int data);
 		void writeAddr(long addr, int length, int data[]);
 		void readAddr(long addr, int length, int data[]);						
+		void writeAddrBytes(long addr, int length, const byte data[]);
 		
 };
 #endif
@@ -44,6 +44,8 @@ def GetGreySubsample(image, roiL, roiT, roiW, roiH, bW, bH, normalize):
   # subsample blocks of BWxBH pixels from the ROI [Left, Top, Width, Height]
   # vector is the output to broadcast to the neurons for learning or recognition
   p = 0
+  min = 255
+  max = 0
   for y in range(roiT, roiT + roiH, bH):
     for x in range(roiL, roiL + roiW, bW):
       Sum=0	
@@ -54,8 +56,6 @@ def GetGreySubsample(image, roiL, roiT, roiW, roiH, bW, bH, normalize):
       vector[p] = (int)(Sum / (bW*bH))
 
       #log the min and max component
-      min = 255
-      max = 0
       if (max < vector[p]):
         max = vector[p]
       if (min > vector[p]):
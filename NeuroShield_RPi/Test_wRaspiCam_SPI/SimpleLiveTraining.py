@@ -33,6 +33,8 @@ def GetGreySubsample(image, roiL, roiT, roiW, roiH, bW, bH, normalize):
   Width=int(roiW)
   Height=int(roiH)
   p = 0
+  min = 255
+  max = 0
   for y in range(Top, Top + Height, bH):
     for x in range(Left, Left + Width, bW):
       Sum=0	
@@ -43,8 +45,6 @@ def GetGreySubsample(image, roiL, roiT, roiW, roiH, bW, bH, normalize):
       vector[p] = (int)(Sum / (bW*bH))
 
       #log the min and max component
-      min = 255
-      max = 0
       if (max < vector[p]):
         max = vector[p]
       if (min > vector[p]):